@@ -0,0 +1,267 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "EntityManager.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <boost/container/flat_map.hpp>
+#include <filesystem>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+constexpr const char* fruInterface = "xyz.openbmc_project.FruDevice";
+
+// fills DBUS_PROBE_OBJECTS with count fru devices, 8 per bus
+static void populateProbeObjects(size_t count)
+{
+    DBUS_PROBE_OBJECTS.clear();
+    PASSED_PROBES.clear();
+    probeObjectsChanged(fruInterface);
+    auto& objects = DBUS_PROBE_OBJECTS[fruInterface];
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        DBusProperties fru;
+        fru["BUS"] = static_cast<uint32_t>(ii / 8);
+        fru["ADDRESS"] = static_cast<uint32_t>(0x50 + ii % 8);
+        fru["BOARD_MANUFACTURER"] = std::string("Intel Corporation");
+        fru["BOARD_PRODUCT_NAME"] = "Synthetic Board " + std::to_string(ii);
+        fru["BOARD_SERIAL_NUMBER"] = "SN" + std::to_string(1000000 + ii);
+        fru["BOARD_PART_NUMBER"] = std::string("H12345-001");
+        fru["PRODUCT_PRODUCT_NAME"] = std::string("Synthetic Product");
+        objects.emplace_back(std::move(fru));
+    }
+}
+
+// shaped like the shipped riser configurations
+static nlohmann::json syntheticRecord(size_t index)
+{
+    std::string name = "Synthetic Board " + std::to_string(index);
+    nlohmann::json record = {
+        {"Name", name},
+        {"Probe", "xyz.openbmc_project.FruDevice({'BOARD_PRODUCT_NAME': '" +
+                      name + "$'})"},
+        {"Type", "Board"},
+        {"xyz.openbmc_project.Inventory.Decorator.Asset",
+         {{"Manufacturer", "$BOARD_MANUFACTURER"},
+          {"Model", "$BOARD_PRODUCT_NAME"},
+          {"PartNumber", "$BOARD_PART_NUMBER"},
+          {"SerialNumber", "$BOARD_SERIAL_NUMBER"}}}};
+
+    nlohmann::json exposes = nlohmann::json::array();
+    exposes.push_back({{"Address", "$address"},
+                       {"Bus", "$bus"},
+                       {"Name", name + " Fru"},
+                       {"Type", "EEPROM"}});
+    for (size_t ii = 0; ii < 8; ii++)
+    {
+        exposes.push_back(
+            {{"Address", "0x4" + std::to_string(ii)},
+             {"Bus", "$bus"},
+             {"Name", name + " Temp " + std::to_string(ii)},
+             {"Thresholds",
+              {{{"Direction", "greater than"},
+                {"Name", "upper critical"},
+                {"Severity", 1},
+                {"Value", 80}},
+               {{"Direction", "less than"},
+                {"Name", "lower non critical"},
+                {"Severity", 0},
+                {"Value", 5}}}},
+             {"Type", "TMP75"}});
+    }
+    record["Exposes"] = std::move(exposes);
+    return record;
+}
+
+// uncached drops the probe cache every iteration so the probe engine is timed,
+// not the lookup of a result computed in the first iteration
+static void BM_probeDbus(benchmark::State& state, bool cached)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    populateProbeObjects(count);
+
+    std::map<std::string, nlohmann::json> matches = {
+        {"BOARD_PRODUCT_NAME", "Synthetic Board"}, {"ADDRESS", 80}};
+    for (auto _ : state)
+    {
+        if (!cached)
+        {
+            state.PauseTiming();
+            probeObjectsChanged(fruInterface);
+            state.ResumeTiming();
+        }
+        std::vector<std::optional<DBusProperties>> devices;
+        bool foundProbe = false;
+        benchmark::DoNotOptimize(
+            probeDbus(fruInterface, matches, devices, foundProbe));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_probeDbus, uncached, false)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000);
+BENCHMARK_CAPTURE(BM_probeDbus, cached, true)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000);
+
+static void BM_probe(benchmark::State& state, bool cached)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    populateProbeObjects(count);
+
+    // evaluate one probe per fru, like a scan over a full configuration set
+    std::vector<std::vector<std::string>> probeCommands;
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        probeCommands.push_back(
+            {syntheticRecord(ii)["Probe"].get<std::string>(), "OR",
+             "FOUND('Synthetic Baseboard')"});
+    }
+    for (auto _ : state)
+    {
+        if (!cached)
+        {
+            state.PauseTiming();
+            probeObjectsChanged(fruInterface);
+            state.ResumeTiming();
+        }
+        for (const auto& probeCommand : probeCommands)
+        {
+            std::vector<std::optional<DBusProperties>> foundDevs;
+            benchmark::DoNotOptimize(probe(probeCommand, foundDevs));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_CAPTURE(BM_probe, uncached, false)
+    ->RangeMultiplier(10)
+    ->Range(10, 1000);
+BENCHMARK_CAPTURE(BM_probe, cached, true)->RangeMultiplier(10)->Range(10, 1000);
+
+static void BM_templateCharReplace(benchmark::State& state)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    populateProbeObjects(count);
+    const auto& devices = DBUS_PROBE_OBJECTS[fruInterface];
+    nlohmann::json base = syntheticRecord(0);
+
+    for (auto _ : state)
+    {
+        size_t foundDeviceIdx = 0;
+        for (const auto& device : devices)
+        {
+            nlohmann::json record = base;
+            for (auto keyPair = record.begin(); keyPair != record.end();
+                 keyPair++)
+            {
+                templateCharReplace(keyPair, device, foundDeviceIdx);
+            }
+            for (auto& expose : record["Exposes"])
+            {
+                for (auto keyPair = expose.begin(); keyPair != expose.end();
+                     keyPair++)
+                {
+                    templateCharReplace(keyPair, device, foundDeviceIdx);
+                }
+            }
+            foundDeviceIdx++;
+            benchmark::DoNotOptimize(record);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_templateCharReplace)->RangeMultiplier(10)->Range(10, 1000);
+
+static void BM_findJsonFiles(benchmark::State& state)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    fs::path dir = fs::temp_directory_path() /
+                   ("entity-manager-bench-" + std::to_string(count));
+    fs::remove_all(dir);
+    fs::create_directories(dir / "schemas");
+    std::ofstream(dir / "schemas" / "global.json") << "{}";
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        std::ofstream(dir / ("board" + std::to_string(ii) + ".json"))
+            << syntheticRecord(ii).dump(4);
+    }
+
+    for (auto _ : state)
+    {
+        std::list<nlohmann::json> configurations;
+        benchmark::DoNotOptimize(findJsonFiles(configurations, dir));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    fs::remove_all(dir);
+}
+BENCHMARK(BM_findJsonFiles)->RangeMultiplier(10)->Range(10, 1000);
+
+static void BM_postToDbus(benchmark::State& state)
+{
+    size_t count = static_cast<size_t>(state.range(0));
+    boost::asio::io_service io;
+    std::shared_ptr<sdbusplus::asio::connection> conn;
+    try
+    {
+        conn = std::make_shared<sdbusplus::asio::connection>(io);
+    }
+    catch (const std::exception&)
+    {
+        state.SkipWithError("postToDbus needs a dbus connection");
+        return;
+    }
+
+    nlohmann::json newConfiguration = nlohmann::json::object();
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        nlohmann::json record = syntheticRecord(ii);
+        record.erase("Probe");
+        newConfiguration[std::to_string(ii)] = std::move(record);
+    }
+    nlohmann::json systemConfiguration = newConfiguration;
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        nlohmann::json published = systemConfiguration;
+        auto objServer = std::make_unique<sdbusplus::asio::object_server>(conn);
+        state.ResumeTiming();
+
+        postToDbus(newConfiguration, published, *objServer);
+
+        // every iteration starts from nothing published: the interfaces
+        // remembered per record are dropped with their paths, so neither
+        // grows with the iteration count
+        state.PauseTiming();
+        for (const auto& item : newConfiguration.items())
+        {
+            pruneConfiguration(published, *objServer, item.key());
+        }
+        objServer.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_postToDbus)->RangeMultiplier(10)->Range(10, 1000);
+
+BENCHMARK_MAIN();
@@ -18,9 +18,113 @@
 
 #include <systemd/sd-journal.h>
 
+#include <InternedString.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/container/flat_map.hpp>
+#include <filesystem>
 #include <iostream>
+#include <list>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+#include <sdbusplus/bus/match.hpp>
 #include <string>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+constexpr const char* configurationDirectory = PACKAGE_DIR "configurations";
+constexpr const char* tempConfigDir = "/tmp/configuration/";
+constexpr const char* lastConfiguration = "/tmp/configuration/last.json";
+constexpr const char* currentConfiguration = "/var/configuration/system.json";
+
+using BasicVariantType =
+    std::variant<std::string, int64_t, uint64_t, double, int32_t, uint32_t,
+                 int16_t, uint16_t, uint8_t, bool>;
+
+// properties of one object, the names repeat in every object of an interface
+// so they are interned
+using DBusProperties =
+    boost::container::flat_map<InternedString, BasicVariantType>;
+
+// interface name -> properties of every object implementing it
+using DBusProbeObjectType =
+    boost::container::flat_map<std::string, std::vector<DBusProperties>>;
+
+extern DBusProbeObjectType DBUS_PROBE_OBJECTS;
+extern std::vector<std::string> PASSED_PROBES;
+extern std::shared_ptr<sdbusplus::asio::connection> SYSTEM_BUS;
+extern nlohmann::json lastJson;
+
+// when set the inputs of every scan are written here, see replayScan
+extern std::string scanCaptureFile;
+
+bool probeDbus(
+    const std::string& interface,
+    const std::map<std::string, nlohmann::json>& matches,
+    std::vector<std::optional<DBusProperties>>& devices,
+    bool& foundProbe);
+
+// probeDbus results and property indexes are kept per interface, this has to
+// be called whenever the objects of an interface in DBUS_PROBE_OBJECTS are
+// replaced
+void probeObjectsChanged(const std::string& interface);
+
+bool probe(
+    const std::vector<std::string>& probeCommand,
+    std::vector<std::optional<DBusProperties>>& foundDevs);
+
+void templateCharReplace(
+    nlohmann::json::iterator& keyPair,
+    const DBusProperties& foundDevice,
+    size_t& foundDeviceIdx);
+
+bool findJsonFiles(
+    std::list<nlohmann::json>& configurations,
+    const std::filesystem::path& configurationDir = configurationDirectory);
+
+bool writeJsonFiles(const nlohmann::json& systemConfiguration);
+
+void postToDbus(const nlohmann::json& newConfiguration,
+                nlohmann::json& systemConfiguration,
+                sdbusplus::asio::object_server& objServer);
+
+// takes a published record and the interfaces postToDbus created for it back
+// off of dbus
+void pruneConfiguration(nlohmann::json& systemConfiguration,
+                        sdbusplus::asio::object_server& objServer,
+                        const std::string& name);
+
+void createStatisticsInterface(sdbusplus::asio::object_server& objServer);
+
+// reads the per PowerState removal grace periods from removal.json
+void loadRemovalPolicy(void);
+
+// publishes lastJson before the first scan has run, the first scan then only
+// adds what is new and removes what wasn't found again
+void publishProvisionalConfiguration(
+    nlohmann::json& systemConfiguration,
+    sdbusplus::asio::object_server& objServer,
+    const std::shared_ptr<sdbusplus::asio::dbus_interface>& entityIface);
+
+// approximate heap bytes and number of entries held by each in-memory store,
+// as (store, bytes, entries)
+std::vector<std::tuple<std::string, uint64_t, uint64_t>> getMemoryUsage(
+    const nlohmann::json& systemConfiguration,
+    const std::vector<sdbusplus::bus::match::match>& dbusMatches);
+
+// runs the probe, template and bind pipeline offline against a capture and
+// prints the resulting configuration and phase timings
+int replayScan(const std::string& captureFile);
+
+// powerGatedOnly limits the scan to configurations that depend on host power,
+// unless another request for a full scan comes in before it starts
+void propertiesChangedCallback(
+    boost::asio::io_service& io,
+    std::vector<sdbusplus::bus::match::match>& dbusMatches,
+    nlohmann::json& systemConfiguration,
+    sdbusplus::asio::object_server& objServer, bool powerGatedOnly = false);
 
 inline void logDeviceAdded(const nlohmann::json& record)
 {
@@ -0,0 +1,170 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parses FRUs laid out per the IPMI Platform Management FRU Information
+// Storage Definition v1.0. Nothing is copied: the areas, fields and records
+// point into the buffer handed to parseFru, which has to outlive them.
+
+enum class FruFieldEncoding : uint8_t
+{
+    binary = 0,
+    bcdPlus = 1,
+    sixBitAscii = 2,
+    // 8 bit ascii and latin 1 for english, 16 bit unicode otherwise
+    text = 3
+};
+
+struct FruField
+{
+    FruFieldEncoding encoding = FruFieldEncoding::binary;
+    std::string_view data;
+
+    // the field as text, without trailing nul bytes. Binary fields are
+    // returned as stored, unicode is converted to utf-8
+    std::string decode(uint8_t language = 0) const;
+};
+
+// the fields the spec defines for each area, in order. Custom fields follow
+enum FruChassisField : size_t
+{
+    chassisPartNumber,
+    chassisSerialNumber,
+    chassisFieldCount
+};
+
+enum FruBoardField : size_t
+{
+    boardManufacturer,
+    boardProductName,
+    boardSerialNumber,
+    boardPartNumber,
+    boardFruFileId,
+    boardFieldCount
+};
+
+enum FruProductField : size_t
+{
+    productManufacturer,
+    productName,
+    productPartNumber,
+    productVersion,
+    productSerialNumber,
+    productAssetTag,
+    productFruFileId,
+    productFieldCount
+};
+
+// a chassis, board or product info area
+struct FruInfoArea
+{
+    // nullptr if the area ends before the field
+    const FruField* field(size_t index) const
+    {
+        return index < fields.size() ? &fields[index] : nullptr;
+    }
+
+    // the whole area, up to and including the checksum
+    std::string_view data;
+    uint8_t version = 0;
+    // the chassis type, or the language code of a board or product area
+    uint8_t typeOrLanguage = 0;
+    // minutes since 1996-01-01 00:00 UTC, only set for a board area
+    uint32_t manufactureMinutes = 0;
+    std::vector<FruField> fields;
+    bool checksumValid = false;
+};
+
+struct FruMultiRecord
+{
+    uint8_t type = 0;
+    uint8_t version = 0;
+    std::string_view data;
+    // both the header and the record checksum
+    bool checksumValid = false;
+};
+
+constexpr uint8_t fruPowerSupplyInfoType = 0x00;
+constexpr uint8_t fruDcOutputType = 0x01;
+
+// voltages are in 10 mV, currents in mA unless noted
+struct FruPowerSupplyInfo
+{
+    uint16_t overallCapacityWatts = 0;
+    uint16_t peakVa = 0;
+    uint8_t inrushCurrentAmps = 0;
+    uint8_t inrushIntervalMs = 0;
+    uint16_t lowInputVoltage1 = 0;
+    uint16_t highInputVoltage1 = 0;
+    uint16_t lowInputVoltage2 = 0;
+    uint16_t highInputVoltage2 = 0;
+    uint8_t lowInputFrequency = 0;
+    uint8_t highInputFrequency = 0;
+    uint8_t dropoutToleranceMs = 0;
+    uint8_t flags = 0;
+    uint8_t holdUpSeconds = 0;
+    uint16_t peakWatts = 0;
+    uint8_t combinedVoltage1 = 0;
+    uint8_t combinedVoltage2 = 0;
+    uint16_t combinedWatts = 0;
+    uint8_t tachometerThreshold = 0;
+};
+
+struct FruDcOutput
+{
+    uint8_t outputNumber = 0;
+    bool standby = false;
+    int16_t nominalVoltage = 0;
+    int16_t maxNegativeDeviation = 0;
+    int16_t maxPositiveDeviation = 0;
+    uint16_t rippleAndNoiseMv = 0;
+    uint16_t minCurrent = 0;
+    uint16_t maxCurrent = 0;
+};
+
+struct FruData
+{
+    // true if the header and every area and record checksum are valid
+    bool checksumsValid(void) const;
+
+    uint8_t formatVersion = 0;
+    bool headerChecksumValid = false;
+    // the internal use area, up to the next area or the end of the buffer
+    std::string_view internal;
+    std::optional<FruInfoArea> chassis;
+    std::optional<FruInfoArea> board;
+    std::optional<FruInfoArea> product;
+    std::vector<FruMultiRecord> multiRecords;
+};
+
+// checks the version, padding, checksum and area offsets of the 8 byte
+// common header
+bool validateFruHeader(std::string_view header);
+
+// nullopt if bytes is shorter than the common header, or an area it lists
+// runs past the end of bytes
+std::optional<FruData> parseFru(std::string_view bytes);
+
+std::optional<FruPowerSupplyInfo>
+    parsePowerSupplyInfo(const FruMultiRecord& record);
+std::optional<FruDcOutput> parseDcOutput(const FruMultiRecord& record);
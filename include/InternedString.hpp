@@ -0,0 +1,74 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string>
+
+// a string stored once for the whole process, used for names that repeat in
+// every object of a kind such as dbus property names. Copies are a pointer and
+// equal strings share storage, so equality is a pointer compare. Ordering is by
+// value so maps keyed by these iterate the same as they would with std::string.
+// Strings are never freed and can only be added from the io thread, reading
+// them from any thread is fine.
+class InternedString
+{
+  public:
+    InternedString();
+    InternedString(const std::string& str);
+    InternedString(const char* str);
+
+    const std::string& str(void) const
+    {
+        return *value;
+    }
+    operator const std::string&(void) const
+    {
+        return *value;
+    }
+
+    bool operator==(const InternedString& other) const
+    {
+        return value == other.value;
+    }
+    bool operator!=(const InternedString& other) const
+    {
+        return value != other.value;
+    }
+    bool operator<(const InternedString& other) const
+    {
+        return value != other.value && *value < *other.value;
+    }
+
+    // the interned copy of str if there is one, a string that was never
+    // interned can't be a key anywhere so lookups don't need to add it
+    static std::optional<InternedString> find(const std::string& str);
+
+    // number of distinct strings and the heap they take up
+    static size_t count(void);
+    static size_t bytes(void);
+
+  private:
+    explicit InternedString(const std::string* str) : value(str)
+    {
+    }
+
+    const std::string* value;
+};
+
+// heap a std::string holding str would take up, including the object itself
+size_t stringBytes(const std::string& str);
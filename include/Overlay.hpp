@@ -18,4 +18,5 @@
 #include <nlohmann/json.hpp>
 
 void unloadAllOverlays(void);
-bool loadOverlays(const nlohmann::json& systemConfiguration);
\ No newline at end of file
+bool loadOverlays(const nlohmann::json& systemConfiguration);
+void unloadOverlays(const nlohmann::json& systemConfiguration);
\ No newline at end of file
@@ -0,0 +1,127 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+enum class ScanPhase
+{
+    debounce,
+    fileLoad,
+    mapperQuery,
+    getManagedObjects,
+    probeEvaluation,
+    templating,
+    overlayLoad,
+    postToDbus,
+    count
+};
+
+constexpr size_t scanPhaseCount = static_cast<size_t>(ScanPhase::count);
+
+// used as the property prefix on dbus, i.e. DebounceLast
+constexpr std::array<const char*, scanPhaseCount> scanPhaseNames = {
+    "Debounce",        "FileLoad",   "MapperQuery", "GetManagedObjects",
+    "ProbeEvaluation", "Templating", "OverlayLoad", "PostToDbus"};
+
+// upper bound of each histogram bucket in microseconds, the last bucket holds
+// everything above the final bound
+constexpr std::array<uint64_t, 7> histogramBucketsUs = {
+    1000, 10000, 100000, 500000, 1000000, 5000000, 10000000};
+
+struct PhaseStatistics
+{
+    void record(uint64_t us)
+    {
+        last = us;
+        min = std::min(min, us);
+        max = std::max(max, us);
+        count++;
+
+        size_t bucket = 0;
+        while (bucket < histogramBucketsUs.size() &&
+               us > histogramBucketsUs[bucket])
+        {
+            bucket++;
+        }
+        histogram[bucket]++;
+    }
+
+    uint64_t last = 0;
+    uint64_t min = std::numeric_limits<uint64_t>::max();
+    uint64_t max = 0;
+    uint64_t count = 0;
+    std::vector<uint64_t> histogram =
+        std::vector<uint64_t>(histogramBucketsUs.size() + 1, 0);
+};
+
+// time is accumulated per phase while a scan is in flight and folded into one
+// sample per phase when the scan completes. Phases that issue several dbus
+// calls (mapper, GetManagedObjects) report the summed round trip time.
+class ScanStatistics
+{
+  public:
+    void accumulate(ScanPhase phase, std::chrono::steady_clock::duration time)
+    {
+        Pending& entry = pending[static_cast<size_t>(phase)];
+        entry.time += time;
+        entry.active = true;
+    }
+
+    void commit(void)
+    {
+        for (size_t ii = 0; ii < scanPhaseCount; ii++)
+        {
+            Pending& entry = pending[ii];
+            if (!entry.active)
+            {
+                continue;
+            }
+            phases[ii].record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    entry.time)
+                    .count()));
+            entry = Pending();
+        }
+    }
+
+    // drops what a scan that didn't complete accumulated
+    void discard(void)
+    {
+        pending = {};
+    }
+
+    const PhaseStatistics& phase(ScanPhase phase) const
+    {
+        return phases[static_cast<size_t>(phase)];
+    }
+
+  private:
+    struct Pending
+    {
+        std::chrono::steady_clock::duration time =
+            std::chrono::steady_clock::duration::zero();
+        bool active = false;
+    };
+
+    std::array<PhaseStatistics, scanPhaseCount> phases;
+    std::array<Pending, scanPhaseCount> pending;
+};
@@ -0,0 +1,67 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// runs cpu bound scan work off the io thread. asio is built without thread
+// support, so workers never touch the io_service; finished jobs are queued and
+// an eventfd wakes the io thread, which runs each completion handler in turn.
+// Work functions must only use what they were handed, completion handlers run
+// on the io thread and may touch any global state. A completion handler is told
+// whether its work threw, so it can drop what the work left half done.
+class ScanWorkers
+{
+  public:
+    ScanWorkers(boost::asio::io_service& io, size_t threads);
+    ~ScanWorkers();
+
+    ScanWorkers(const ScanWorkers&) = delete;
+    ScanWorkers& operator=(const ScanWorkers&) = delete;
+
+    void post(std::function<void(void)>&& work,
+              std::function<void(bool failed)>&& done);
+
+  private:
+    void worker(void);
+    void waitForCompleted(void);
+    void runCompleted(void);
+
+    boost::asio::posix::stream_descriptor wakeup;
+    uint64_t wakeupCount = 0;
+    bool waiting = false;
+    // jobs posted whose completion handler hasn't run yet, the eventfd is
+    // only watched while there are some so io.run() can return when idle
+    size_t outstanding = 0;
+
+    std::mutex lock;
+    std::condition_variable workAvailable;
+    std::deque<
+        std::pair<std::function<void(void)>, std::function<void(bool)>>>
+        jobs;
+    std::deque<std::pair<std::function<void(bool)>, bool>> completed;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
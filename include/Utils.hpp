@@ -18,6 +18,7 @@
 #include <boost/container/flat_map.hpp>
 #include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <nlohmann/json.hpp>
 #include <sdbusplus/asio/connection.hpp>
@@ -39,7 +40,9 @@ bool validateJson(const nlohmann::json& schemaFile,
                   const nlohmann::json& input);
 
 bool isPowerOn(void);
-void setupPowerMatch(const std::shared_ptr<sdbusplus::asio::connection>& conn);
+// powerChanged is called on every pgood transition
+void setupPowerMatch(const std::shared_ptr<sdbusplus::asio::connection>& conn,
+                     std::function<void(bool)>&& powerChanged = nullptr);
 struct DBusInternalError final : public sdbusplus::exception_t
 {
     const char* name() const noexcept override
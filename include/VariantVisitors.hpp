@@ -15,8 +15,13 @@
 */
 
 #pragma once
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdio>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <variant>
 
 struct VariantToFloatVisitor
@@ -76,6 +81,46 @@ struct VariantToStringVisitor
     }
 };
 
+// like VariantToStringVisitor, but string alternatives are returned as a view
+// of the variant and numbers are formatted into the visitor, so nothing is
+// allocated. The view is valid while both the variant and the visitor are
+struct VariantToStringViewVisitor
+{
+    template <typename T>
+    std::string_view operator()(const T& t)
+    {
+        if constexpr (std::is_same_v<T, std::string>)
+        {
+            return t;
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            // same format as std::to_string
+            int size = std::snprintf(buffer.data(), buffer.size(), "%f",
+                                     static_cast<double>(t));
+            return std::string_view(
+                buffer.data(),
+                std::min(static_cast<size_t>(size), buffer.size() - 1));
+        }
+        else if constexpr (std::is_same_v<T, bool>)
+        {
+            buffer[0] = t ? '1' : '0';
+            return std::string_view(buffer.data(), 1);
+        }
+        else if constexpr (std::is_arithmetic_v<T>)
+        {
+            auto result =
+                std::to_chars(buffer.data(), buffer.data() + buffer.size(), t);
+            return std::string_view(
+                buffer.data(), static_cast<size_t>(result.ptr - buffer.data()));
+        }
+        throw std::invalid_argument("Cannot translate type to string");
+    }
+
+    // fits any double printed with %f
+    std::array<char, 320> buffer;
+};
+
 struct VariantToDoubleVisitor
 {
     template <typename T>
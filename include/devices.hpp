@@ -65,4 +65,39 @@ const boost::container::flat_map<const char*, ExportTemplate, CmpStr>
          {"TMP112",
           ExportTemplate("tmp112 $Address",
                          "/sys/bus/i2c/devices/i2c-$Bus/new_device")}}};
+
+// how devices created from exportTemplates are taken down again
+const boost::container::flat_map<const char*, ExportTemplate, CmpStr>
+    removeTemplates{
+        {{"EEPROM",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"Gpio", ExportTemplate("$Index", "/sys/class/gpio/unexport")},
+         {"PCA9543Mux",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"PCA9544Mux",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"PCA9545Mux",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"PCA9546Mux",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"pmbus",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"TMP75",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"TMP421",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"EMC1413",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")},
+         {"TMP112",
+          ExportTemplate("$Address",
+                         "/sys/bus/i2c/devices/i2c-$Bus/delete_device")}}};
 } // namespace devices
@@ -16,7 +16,11 @@
 
 #include "EntityManager.hpp"
 
+#include <malloc.h>
+
 #include <Overlay.hpp>
+#include <ScanStatistics.hpp>
+#include <ScanWorkers.hpp>
 #include <Utils.hpp>
 #include <VariantVisitors.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
@@ -28,22 +32,23 @@
 #include <boost/container/flat_set.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <chrono>
+#include <cmath>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <nlohmann/json.hpp>
 #include <regex>
 #include <sdbusplus/asio/connection.hpp>
 #include <sdbusplus/asio/object_server.hpp>
 #include <variant>
 
-constexpr const char* configurationDirectory = PACKAGE_DIR "configurations";
 constexpr const char* schemaDirectory = PACKAGE_DIR "configurations/schemas";
-constexpr const char* tempConfigDir = "/tmp/configuration/";
-constexpr const char* lastConfiguration = "/tmp/configuration/last.json";
-constexpr const char* currentConfiguration = "/var/configuration/system.json";
 constexpr const char* globalSchema = "global.json";
 constexpr const char* templateChar = "$";
+constexpr const char* removalPolicyPath = PACKAGE_DIR "removal.json";
 constexpr const int32_t MAX_MAPPER_DEPTH = 0;
 
 constexpr const bool DEBUG = false;
@@ -76,15 +81,25 @@ const static boost::container::flat_map<const char*, probe_type_codes, cmp_str>
                  {"FOUND", probe_type_codes::FOUND},
                  {"MATCH_ONE", probe_type_codes::MATCH_ONE}}};
 
+// where an evaluation of a probe array is, so it can stop at a term whose dbus
+// objects haven't been fetched yet and continue from there
+struct ProbeState
+{
+    size_t index = 0;
+    bool ret = false;
+    bool cur = true;
+    bool first = true;
+    bool matchOne = false;
+    probe_type_codes lastCommand = probe_type_codes::FALSE_T;
+    std::vector<std::optional<DBusProperties>> foundDevs;
+};
+
 static constexpr std::array<const char*, 5> settableInterfaces = {
     "FanProfile", "Pid", "Pid.Zone", "Stepwise", "Thresholds"};
 using JsonVariantType =
     std::variant<std::vector<std::string>, std::vector<double>, std::string,
                  int64_t, uint64_t, double, int32_t, uint32_t, int16_t,
                  uint16_t, uint8_t, bool>;
-using BasicVariantType =
-    std::variant<std::string, int64_t, uint64_t, double, int32_t, uint32_t,
-                 int16_t, uint16_t, uint8_t, bool>;
 
 using GetSubTreeType = std::vector<
     std::pair<std::string,
@@ -96,15 +111,67 @@ using ManagedObjectType = boost::container::flat_map<
         std::string,
         boost::container::flat_map<std::string, BasicVariantType>>>;
 
-boost::container::flat_map<
+DBusProbeObjectType DBUS_PROBE_OBJECTS;
+
+// the objects probes were evaluated against before a full scan fetches them
+// again, an interface that comes back the same keeps its cached results
+static DBusProbeObjectType previousProbeObjects;
+
+// objects of an interface by the value of one property, for equality matches
+struct PropertyIndex
+{
+    // false when a value of the property can't be converted to a number
+    bool usable = true;
+    boost::container::flat_map<int64_t, std::vector<size_t>> objects;
+};
+static boost::container::flat_map<
+    std::string, boost::container::flat_map<std::string, PropertyIndex>>
+    propertyIndexes;
+
+// results of probeDbus for each distinct set of matches, as indexes into the
+// objects of the interface. They are kept across scans and dropped by
+// probeObjectsChanged once a fetch returns different objects for the
+// interface, or a power transition fetches them again
+static boost::container::flat_map<
     std::string,
-    std::vector<boost::container::flat_map<std::string, BasicVariantType>>>
-    DBUS_PROBE_OBJECTS;
+    boost::container::flat_map<std::string, std::vector<size_t>>>
+    probeCache;
+
 std::vector<std::string> PASSED_PROBES;
 
 // todo: pass this through nicer
 std::shared_ptr<sdbusplus::asio::connection> SYSTEM_BUS;
-static nlohmann::json lastJson;
+nlohmann::json lastJson;
+
+static ScanStatistics scanStatistics;
+
+static std::shared_ptr<sdbusplus::asio::dbus_interface> statisticsIface;
+
+// interfaces published for each record in the system configuration, so they
+// can be taken off of dbus when the record goes away
+static boost::container::flat_map<
+    std::string, std::vector<std::weak_ptr<sdbusplus::asio::dbus_interface>>>
+    inventory;
+
+// set while the configuration published at startup from lastJson has not
+// been confirmed by a scan
+static bool provisionalConfiguration = false;
+static std::shared_ptr<sdbusplus::asio::dbus_interface> provisionalIface;
+
+// seconds a record has to stay missing before it is removed, by PowerState.
+// Can be overridden from removal.json
+static boost::container::flat_map<std::string, uint64_t> removalGracePeriods = {
+    {"Always", 10}, {"BiosPost", 10}, {"On", 10}};
+
+// records the last scan didn't find, and when they will be removed
+static boost::container::flat_map<std::string,
+                                  std::chrono::steady_clock::time_point>
+    pendingRemovals;
+static size_t scansInProgress = 0;
+
+std::string scanCaptureFile;
+// replay runs without a power match, it uses the state that was captured
+static std::optional<bool> capturedPowerState;
 
 const std::regex ILLEGAL_DBUS_PATH_REGEX("[^A-Za-z0-9_.]");
 const std::regex ILLEGAL_DBUS_MEMBER_REGEX("[^A-Za-z0-9_]");
@@ -114,22 +181,51 @@ void registerCallbacks(boost::asio::io_service& io,
                        nlohmann::json& systemConfiguration,
                        sdbusplus::asio::object_server& objServer);
 
+// store reference to probes waiting on the objects of an interface, so we
+// don't overwhelm services and can continue them once the objects arrive
+static boost::container::flat_map<std::string,
+                                  std::vector<std::shared_ptr<PerformProbe>>>
+    pendingProbes;
+
+static void finishDbusObjects(const std::string& interface,
+                              std::vector<DBusProperties>&& objects);
+
+// every object of an interface repeats the same property names, only one copy
+// of each is kept
+static DBusProperties internProperties(
+    const boost::container::flat_map<std::string, BasicVariantType>&
+        properties)
+{
+    DBusProperties interned;
+    interned.reserve(properties.size());
+    for (const auto& property : properties)
+    {
+        // both are ordered by name
+        interned.emplace_hint(interned.end(), property.first,
+                              property.second);
+    }
+    return interned;
+}
+
 // calls the mapper to find all exposed objects of an interface type
 // and creates a vector<flat_map> that contains all the key value pairs
-// getManagedObjects
-void findDbusObjects(std::shared_ptr<PerformProbe> probe,
+// getManagedObjects. Returns true if the objects are already available,
+// otherwise probe is run again once they are
+bool findDbusObjects(std::shared_ptr<PerformProbe> probe,
                      std::shared_ptr<sdbusplus::asio::connection> connection,
-                     std::string& interface)
+                     const std::string& interface)
 {
+    // an interface with no objects is still recorded, so it isn't fetched
+    // again for every probe that uses it
+    if (DBUS_PROBE_OBJECTS.find(interface) != DBUS_PROBE_OBJECTS.end())
+    {
+        return true;
+    }
 
-    // store reference to pending callbacks so we don't overwhelm services
-    static boost::container::flat_map<
-        std::string, std::vector<std::shared_ptr<PerformProbe>>>
-        pendingProbes;
-
-    if (DBUS_PROBE_OBJECTS[interface].size())
+    // replaying a capture, only the recorded objects exist
+    if (!connection)
     {
-        return;
+        return true;
     }
 
     // add shared_ptr to vector of Probes waiting for callback from a specific
@@ -141,20 +237,26 @@ void findDbusObjects(std::shared_ptr<PerformProbe> probe,
     // only allow first call to run to not overwhelm processes
     if (iter != pending.begin())
     {
-        return;
+        return false;
     }
 
     // find all connections in the mapper that expose a specific type
+    auto mapperStart = std::chrono::steady_clock::now();
     connection->async_method_call(
-        [connection, interface, probe](boost::system::error_code& ec,
-                                       const GetSubTreeType& interfaceSubtree) {
+        [connection, interface,
+         mapperStart](boost::system::error_code& ec,
+                      const GetSubTreeType& interfaceSubtree) {
+            scanStatistics.accumulate(ScanPhase::mapperQuery,
+                                      std::chrono::steady_clock::now() -
+                                          mapperStart);
             boost::container::flat_set<std::string> interfaceConnections;
             if (ec)
             {
-                pendingProbes[interface].clear();
                 if (ec.value() == ENOENT)
                 {
-                    return; // wasn't found by mapper
+                    // wasn't found by mapper
+                    finishDbusObjects(interface, {});
+                    return;
                 }
                 std::cerr << "Error communicating to mapper.\n";
 
@@ -173,38 +275,51 @@ void findDbusObjects(std::shared_ptr<PerformProbe> probe,
             }
             if (interfaceConnections.empty())
             {
-                pendingProbes[interface].clear();
+                finishDbusObjects(interface, {});
                 return;
             }
+
+            // objects are only published once every connection has answered,
+            // so no probe sees a partial set
+            auto remaining =
+                std::make_shared<size_t>(interfaceConnections.size());
+            auto found = std::make_shared<std::vector<DBusProperties>>();
+
             // get managed objects for all interfaces
             for (const auto& conn : interfaceConnections)
             {
+                auto managedStart = std::chrono::steady_clock::now();
                 connection->async_method_call(
-                    [conn,
-                     interface](boost::system::error_code& errc,
-                                const ManagedObjectType& managedInterface) {
+                    [conn, interface, managedStart, remaining,
+                     found](boost::system::error_code& errc,
+                            const ManagedObjectType& managedInterface) {
+                        scanStatistics.accumulate(
+                            ScanPhase::getManagedObjects,
+                            std::chrono::steady_clock::now() - managedStart);
                         if (errc)
                         {
                             std::cerr
                                 << "error getting managed object for device "
                                 << conn << "\n";
-                            pendingProbes[interface].clear();
-                            return;
                         }
-                        for (auto& interfaceManagedObj : managedInterface)
+                        else
                         {
-                            auto ifaceObjFind =
-                                interfaceManagedObj.second.find(interface);
-                            if (ifaceObjFind !=
-                                interfaceManagedObj.second.end())
+                            for (auto& interfaceManagedObj : managedInterface)
                             {
-                                std::vector<boost::container::flat_map<
-                                    std::string, BasicVariantType>>&
-                                    dbusObject = DBUS_PROBE_OBJECTS[interface];
-                                dbusObject.emplace_back(ifaceObjFind->second);
+                                auto ifaceObjFind =
+                                    interfaceManagedObj.second.find(interface);
+                                if (ifaceObjFind !=
+                                    interfaceManagedObj.second.end())
+                                {
+                                    found->emplace_back(internProperties(
+                                        ifaceObjFind->second));
+                                }
                             }
                         }
-                        pendingProbes[interface].clear();
+                        if (--(*remaining) == 0)
+                        {
+                            finishDbusObjects(interface, std::move(*found));
+                        }
                     },
                     conn.c_str(), "/", "org.freedesktop.DBus.ObjectManager",
                     "GetManagedObjects");
@@ -214,310 +329,999 @@ void findDbusObjects(std::shared_ptr<PerformProbe> probe,
         "/xyz/openbmc_project/object_mapper",
         "xyz.openbmc_project.ObjectMapper", "GetSubTree", "/", MAX_MAPPER_DEPTH,
         objects);
+    return false;
 }
-// probes dbus interface dictionary for a key with a value that matches a regex
-bool probeDbus(
-    const std::string& interface,
-    const std::map<std::string, nlohmann::json>& matches,
-    std::vector<std::optional<
-        boost::container::flat_map<std::string, BasicVariantType>>>& devices,
-    bool& foundProbe)
+
+// integers stay integers so 64 bit values compare exactly, only double
+// operands and properties are compared as doubles
+using ProbeNumber = std::variant<int64_t, uint64_t, double>;
+
+static ProbeNumber probeNumber(const nlohmann::json& value)
 {
-    std::vector<boost::container::flat_map<std::string, BasicVariantType>>&
-        dbusObject = DBUS_PROBE_OBJECTS[interface];
-    if (dbusObject.empty())
+    if (value.is_number_unsigned())
     {
-        foundProbe = false;
-        return false;
+        return value.get<uint64_t>();
     }
-    foundProbe = true;
+    if (value.is_number_integer())
+    {
+        return value.get<int64_t>();
+    }
+    return value.get<double>();
+}
 
-    bool foundMatch = false;
-    for (auto& device : dbusObject)
+// exact ordering of an integer against a double that isn't NaN
+template <typename Integer>
+static int compareIntegerDouble(Integer integer, double value)
+{
+    // both limits are powers of two, so exact as doubles
+    if (value < static_cast<double>(std::numeric_limits<Integer>::min()))
     {
-        bool deviceMatches = true;
-        for (auto& match : matches)
-        {
-            auto deviceValue = device.find(match.first);
-            if (deviceValue != device.end())
+        return 1;
+    }
+    if (value >= std::ldexp(1.0, std::numeric_limits<Integer>::digits))
+    {
+        return -1;
+    }
+    double whole = std::trunc(value);
+    Integer truncated = static_cast<Integer>(whole);
+    if (integer != truncated)
+    {
+        return integer < truncated ? -1 : 1;
+    }
+    if (value == whole)
+    {
+        return 0;
+    }
+    return value > whole ? -1 : 1;
+}
+
+// negative, zero or positive as left is less, equal or greater than right,
+// nullopt when a NaN makes them unordered
+static std::optional<int> compareNumbers(const ProbeNumber& left,
+                                         const ProbeNumber& right)
+{
+    return std::visit(
+        [](auto lhs, auto rhs) -> std::optional<int> {
+            using Left = decltype(lhs);
+            using Right = decltype(rhs);
+            if constexpr (std::is_same_v<Left, double> &&
+                          std::is_same_v<Right, double>)
             {
-                switch (match.second.type())
+                if (std::isnan(lhs) || std::isnan(rhs))
                 {
-                    case nlohmann::json::value_t::string:
-                    {
-                        std::regex search(match.second.get<std::string>());
-                        std::smatch regMatch;
-
-                        // convert value to string respresentation
-                        std::string probeValue = std::visit(
-                            VariantToStringVisitor(), deviceValue->second);
-                        if (!std::regex_search(probeValue, regMatch, search))
-                        {
-                            deviceMatches = false;
-                            break;
-                        }
-                        break;
-                    }
-                    case nlohmann::json::value_t::boolean:
-                    case nlohmann::json::value_t::number_unsigned:
-                    {
-                        unsigned int probeValue = std::visit(
-                            VariantToUnsignedIntVisitor(), deviceValue->second);
-
-                        if (probeValue != match.second.get<unsigned int>())
-                        {
-                            deviceMatches = false;
-                        }
-                        break;
-                    }
-                    case nlohmann::json::value_t::number_integer:
-                    {
-                        int probeValue = std::visit(VariantToIntVisitor(),
-                                                    deviceValue->second);
-
-                        if (probeValue != match.second.get<int>())
-                        {
-                            deviceMatches = false;
-                        }
-                        break;
-                    }
-                    case nlohmann::json::value_t::number_float:
-                    {
-                        float probeValue = std::visit(VariantToFloatVisitor(),
-                                                      deviceValue->second);
-
-                        if (probeValue != match.second.get<float>())
-                        {
-                            deviceMatches = false;
-                        }
-                        break;
-                    }
-                    default:
-                    {
-                        std::cerr << "unexpected dbus probe type "
-                                  << match.second.type_name() << "\n";
-                    }
+                    return std::nullopt;
+                }
+                return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+            }
+            else if constexpr (std::is_same_v<Left, double>)
+            {
+                if (std::isnan(lhs))
+                {
+                    return std::nullopt;
+                }
+                return -compareIntegerDouble(rhs, lhs);
+            }
+            else if constexpr (std::is_same_v<Right, double>)
+            {
+                if (std::isnan(rhs))
+                {
+                    return std::nullopt;
+                }
+                return compareIntegerDouble(lhs, rhs);
+            }
+            else if constexpr (std::is_same_v<Left, Right>)
+            {
+                return lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+            }
+            else if constexpr (std::is_same_v<Left, int64_t>)
+            {
+                if (lhs < 0)
+                {
+                    return -1;
                 }
+                uint64_t value = static_cast<uint64_t>(lhs);
+                return value < rhs ? -1 : (value > rhs ? 1 : 0);
             }
             else
             {
-                deviceMatches = false;
-                break;
+                if (rhs < 0)
+                {
+                    return 1;
+                }
+                uint64_t value = static_cast<uint64_t>(rhs);
+                return lhs < value ? -1 : (lhs > value ? 1 : 0);
             }
-        }
-        if (deviceMatches)
-        {
-            devices.emplace_back(device);
-            foundMatch = true;
-            deviceMatches = false; // for next iteration
-        }
-    }
-    return foundMatch;
+        },
+        left, right);
 }
 
-// default probe entry point, iterates a list looking for specific types to
-// call specific probe functions
-bool probe(
-    const std::vector<std::string>& probeCommand,
-    std::vector<std::optional<
-        boost::container::flat_map<std::string, BasicVariantType>>>& foundDevs)
+// a typed comparison from a probe match written as an object, such as
+// {'ADDRESS': {'>=': 80, '<': 88}}
+struct ProbeComparison
 {
-    const static std::regex command(R"(\((.*)\))");
-    std::smatch match;
-    bool ret = false;
-    bool matchOne = false;
-    bool cur = true;
-    probe_type_codes lastCommand = probe_type_codes::FALSE_T;
-    bool first = true;
+    enum class Op
+    {
+        less,
+        lessEqual,
+        greater,
+        greaterEqual,
+        range,
+        in,
+        mask
+    };
+    Op op;
+    std::vector<ProbeNumber> values;
+    uint64_t mask = 0;
+    uint64_t maskValue = 0;
+};
 
-    for (auto& probe : probeCommand)
+// compiled once per distinct match, nullopt if it doesn't compile
+static boost::container::flat_map<
+    std::string, std::optional<std::vector<ProbeComparison>>>
+    compiledComparisons;
+
+static std::optional<std::vector<ProbeComparison>>
+    compileComparisons(const nlohmann::json& match)
+{
+    const static boost::container::flat_map<std::string, ProbeComparison::Op>
+        operators = {{"<", ProbeComparison::Op::less},
+                     {"<=", ProbeComparison::Op::lessEqual},
+                     {">", ProbeComparison::Op::greater},
+                     {">=", ProbeComparison::Op::greaterEqual},
+                     {"range", ProbeComparison::Op::range},
+                     {"in", ProbeComparison::Op::in},
+                     {"mask", ProbeComparison::Op::mask}};
+
+    std::vector<ProbeComparison> comparisons;
+    for (const auto& item : match.items())
     {
-        bool foundProbe = false;
-        boost::container::flat_map<const char*, probe_type_codes,
-                                   cmp_str>::const_iterator probeType;
+        auto findOp = operators.find(item.key());
+        if (findOp == operators.end())
+        {
+            std::cerr << "unknown probe comparison " << item.key() << "\n";
+            return std::nullopt;
+        }
+        ProbeComparison comparison;
+        comparison.op = findOp->second;
 
-        for (probeType = PROBE_TYPES.begin(); probeType != PROBE_TYPES.end();
-             probeType++)
+        const nlohmann::json& operand = item.value();
+        if (comparison.op == ProbeComparison::Op::mask)
         {
-            if (probe.find(probeType->first) != std::string::npos)
+            // [mask, value], matches when (property & mask) == value
+            if (operand.type() != nlohmann::json::value_t::array ||
+                operand.size() != 2 || !operand[0].is_number_unsigned() ||
+                !operand[1].is_number_unsigned())
             {
-                foundProbe = true;
-                break;
+                std::cerr << "probe mask must be [mask, value]\n";
+                return std::nullopt;
             }
+            comparison.mask = operand[0].get<uint64_t>();
+            comparison.maskValue = operand[1].get<uint64_t>();
         }
-        if (foundProbe)
+        else if (operand.type() == nlohmann::json::value_t::array)
         {
-            switch (probeType->second)
+            for (const auto& value : operand)
             {
-                case probe_type_codes::FALSE_T:
-                {
-                    cur = false;
-                    break;
-                }
-                case probe_type_codes::TRUE_T:
-                {
-                    cur = true;
-                    break;
-                }
-                case probe_type_codes::MATCH_ONE:
-                {
-                    // set current value to last, this probe type shouldn't
-                    // affect the outcome
-                    cur = ret;
-                    matchOne = true;
-                    break;
-                }
-                /*case probe_type_codes::AND:
-                  break;
-                case probe_type_codes::OR:
-                  break;
-                  // these are no-ops until the last command switch
-                  */
-                case probe_type_codes::FOUND:
+                if (!value.is_number())
                 {
-                    if (!std::regex_search(probe, match, command))
-                    {
-                        std::cerr << "found probe syntax error " << probe
-                                  << "\n";
-                        return false;
-                    }
-                    std::string commandStr = *(match.begin() + 1);
-                    boost::replace_all(commandStr, "'", "");
-                    cur = (std::find(PASSED_PROBES.begin(), PASSED_PROBES.end(),
-                                     commandStr) != PASSED_PROBES.end());
-                    break;
-                }
-                default:
-                {
-                    break;
+                    std::cerr << "probe comparison " << item.key()
+                              << " expects numbers\n";
+                    return std::nullopt;
                 }
+                comparison.values.push_back(probeNumber(value));
             }
-        }
-        // look on dbus for object
-        else
-        {
-            if (!std::regex_search(probe, match, command))
-            {
-                std::cerr << "dbus probe syntax error " << probe << "\n";
-                return false;
-            }
-            std::string commandStr = *(match.begin() + 1);
-            // convert single ticks and single slashes into legal json
-            boost::replace_all(commandStr, "'", "\"");
-            boost::replace_all(commandStr, R"(\)", R"(\\)");
-            auto json = nlohmann::json::parse(commandStr, nullptr, false);
-            if (json.is_discarded())
+            if (comparison.op == ProbeComparison::Op::range &&
+                comparison.values.size() != 2)
             {
-                std::cerr << "dbus command syntax error " << commandStr << "\n";
-                return false;
+                std::cerr << "probe range must be [min, max]\n";
+                return std::nullopt;
             }
-            // we can match any (string, variant) property. (string, string)
-            // does a regex
-            std::map<std::string, nlohmann::json> dbusProbeMap =
-                json.get<std::map<std::string, nlohmann::json>>();
-            auto findStart = probe.find("(");
-            if (findStart == std::string::npos)
+            if (comparison.op != ProbeComparison::Op::range &&
+                comparison.op != ProbeComparison::Op::in)
             {
-                return false;
+                std::cerr << "probe comparison " << item.key()
+                          << " expects a number\n";
+                return std::nullopt;
             }
-            std::string probeInterface = probe.substr(0, findStart);
-            cur =
-                probeDbus(probeInterface, dbusProbeMap, foundDevs, foundProbe);
-        }
-
-        // some functions like AND and OR only take affect after the
-        // fact
-        if (lastCommand == probe_type_codes::AND)
-        {
-            ret = cur && ret;
         }
-        else if (lastCommand == probe_type_codes::OR)
+        else if (operand.is_number() &&
+                 comparison.op != ProbeComparison::Op::range &&
+                 comparison.op != ProbeComparison::Op::in)
         {
-            ret = cur || ret;
+            comparison.values.push_back(probeNumber(operand));
         }
-
-        if (first)
+        else
         {
-            ret = cur;
-            first = false;
+            std::cerr << "invalid operand for probe comparison " << item.key()
+                      << "\n";
+            return std::nullopt;
         }
-        lastCommand = probeType != PROBE_TYPES.end()
-                          ? probeType->second
-                          : probe_type_codes::FALSE_T;
+        comparisons.push_back(std::move(comparison));
     }
+    return comparisons;
+}
 
-    // probe passed, but empty device
-    if (ret && foundDevs.size() == 0)
-    {
-        foundDevs.emplace_back(std::nullopt);
-    }
-    if (matchOne && ret)
+// configurations are compiled when they load, the compile here is for probes
+// that come from elsewhere
+static const std::optional<std::vector<ProbeComparison>>&
+    compiledComparison(const nlohmann::json& match)
+{
+    std::string key = match.dump();
+    auto compiled = compiledComparisons.find(key);
+    if (compiled == compiledComparisons.end())
     {
-        // match the last one
-        auto last = foundDevs.back();
-        foundDevs.clear();
-
-        foundDevs.emplace_back(std::move(last));
+        compiled =
+            compiledComparisons.emplace(key, compileComparisons(match)).first;
     }
-    return ret;
+    return compiled->second;
 }
-// this class finds the needed dbus fields and on destruction runs the probe
-struct PerformProbe : std::enable_shared_from_this<PerformProbe>
-{
 
-    PerformProbe(
-        const std::vector<std::string>& probeCommand,
-        std::function<void(std::vector<std::optional<boost::container::flat_map<
-                               std::string, BasicVariantType>>>&)>&& callback) :
-        _probeCommand(probeCommand),
-        _callback(std::move(callback))
-    {
-    }
-    ~PerformProbe()
+static bool compareProbeValue(const std::vector<ProbeComparison>& comparisons,
+                              const BasicVariantType& variant)
+{
+    // strings never compare as numbers
+    if (std::holds_alternative<std::string>(variant))
     {
-        std::vector<std::optional<
-            boost::container::flat_map<std::string, BasicVariantType>>>
-            foundDevs;
-        if (probe(_probeCommand, foundDevs))
-        {
-            _callback(foundDevs);
-        }
+        return false;
     }
-    void run()
-    {
-        // parse out dbus probes by discarding other probe types
-
-        for (std::string& probe : _probeCommand)
-        {
-            bool found = false;
-            boost::container::flat_map<const char*, probe_type_codes,
-                                       cmp_str>::const_iterator probeType;
-            for (probeType = PROBE_TYPES.begin();
-                 probeType != PROBE_TYPES.end(); probeType++)
+    ProbeNumber value = std::visit(
+        [](auto property) -> ProbeNumber {
+            using Property = decltype(property);
+            if constexpr (std::is_same_v<Property, std::string>)
             {
-                if (probe.find(probeType->first) != std::string::npos)
-                {
-                    found = true;
-                    break;
-                }
+                return ProbeNumber();
             }
-            if (found)
+            else if constexpr (std::is_same_v<Property, double>)
             {
-                continue;
+                return property;
+            }
+            else if constexpr (std::is_signed_v<Property>)
+            {
+                return ProbeNumber(std::in_place_type<int64_t>, property);
+            }
+            else
+            {
+                return ProbeNumber(std::in_place_type<uint64_t>, property);
             }
-            // syntax requires probe before first open brace
-            auto findStart = probe.find("(");
-            std::string interface = probe.substr(0, findStart);
+        },
+        variant);
 
-            findDbusObjects(shared_from_this(), SYSTEM_BUS, interface);
-        }
+    for (const ProbeComparison& comparison : comparisons)
+    {
+        bool matches = false;
+        switch (comparison.op)
+        {
+            case ProbeComparison::Op::less:
+            {
+                std::optional<int> order =
+                    compareNumbers(value, comparison.values[0]);
+                matches = order && *order < 0;
+                break;
+            }
+            case ProbeComparison::Op::lessEqual:
+            {
+                std::optional<int> order =
+                    compareNumbers(value, comparison.values[0]);
+                matches = order && *order <= 0;
+                break;
+            }
+            case ProbeComparison::Op::greater:
+            {
+                std::optional<int> order =
+                    compareNumbers(value, comparison.values[0]);
+                matches = order && *order > 0;
+                break;
+            }
+            case ProbeComparison::Op::greaterEqual:
+            {
+                std::optional<int> order =
+                    compareNumbers(value, comparison.values[0]);
+                matches = order && *order >= 0;
+                break;
+            }
+            case ProbeComparison::Op::range:
+            {
+                std::optional<int> low =
+                    compareNumbers(value, comparison.values[0]);
+                std::optional<int> high =
+                    compareNumbers(value, comparison.values[1]);
+                matches = low && high && *low >= 0 && *high <= 0;
+                break;
+            }
+            case ProbeComparison::Op::in:
+            {
+                matches = std::any_of(
+                    comparison.values.begin(), comparison.values.end(),
+                    [&value](const ProbeNumber& candidate) {
+                        std::optional<int> order =
+                            compareNumbers(value, candidate);
+                        return order && *order == 0;
+                    });
+                break;
+            }
+            case ProbeComparison::Op::mask:
+            {
+                // only integer properties have bits to mask
+                uint64_t bits = 0;
+                if (const uint64_t* unsignedValue =
+                        std::get_if<uint64_t>(&value))
+                {
+                    bits = *unsignedValue;
+                }
+                else if (const int64_t* signedValue =
+                             std::get_if<int64_t>(&value);
+                         signedValue != nullptr && *signedValue >= 0)
+                {
+                    bits = static_cast<uint64_t>(*signedValue);
+                }
+                else
+                {
+                    break;
+                }
+                matches = (bits & comparison.mask) == comparison.maskValue;
+                break;
+            }
+        }
+        if (!matches)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// returns the objects whose property equals value, or one of the values of an
+// 'in' comparison. nullopt if the match can't be answered from an index and
+// every object has to be checked
+static std::optional<std::vector<size_t>> indexedObjects(
+    const std::string& interface,
+    const std::vector<DBusProperties>& objects,
+    const std::string& property, const nlohmann::json& value)
+{
+    bool isUnsigned = false;
+    std::vector<int64_t> keys;
+    switch (value.type())
+    {
+        case nlohmann::json::value_t::boolean:
+        case nlohmann::json::value_t::number_unsigned:
+        {
+            isUnsigned = true;
+            keys.push_back(value.get<unsigned int>());
+            break;
+        }
+        case nlohmann::json::value_t::number_integer:
+        {
+            keys.push_back(value.get<int>());
+            break;
+        }
+        case nlohmann::json::value_t::object:
+        {
+            // the index is a superset here, the comparison is checked again
+            // on every candidate
+            auto findIn = value.find("in");
+            if (value.size() != 1 || findIn == value.end() ||
+                findIn->type() != nlohmann::json::value_t::array)
+            {
+                return std::nullopt;
+            }
+            isUnsigned = true;
+            for (const auto& item : *findIn)
+            {
+                if (!item.is_number_unsigned() ||
+                    item.get<uint64_t>() >
+                        std::numeric_limits<unsigned int>::max())
+                {
+                    return std::nullopt;
+                }
+                keys.push_back(item.get<unsigned int>());
+            }
+            break;
+        }
+        default:
+        {
+            return std::nullopt;
+        }
+    }
+
+    // keyed by how the value is converted, the same as the linear match
+    auto& indexes = propertyIndexes[interface];
+    std::string indexName = (isUnsigned ? "u:" : "i:") + property;
+    auto findIndex = indexes.find(indexName);
+    if (findIndex == indexes.end())
+    {
+        findIndex = indexes.emplace(indexName, PropertyIndex()).first;
+        PropertyIndex& index = findIndex->second;
+        // a name that was never interned isn't a property of any object
+        std::optional<InternedString> name = InternedString::find(property);
+        try
+        {
+            for (size_t idx = 0; name && idx < objects.size(); idx++)
+            {
+                auto found = objects[idx].find(*name);
+                if (found == objects[idx].end())
+                {
+                    continue;
+                }
+                int64_t converted =
+                    isUnsigned
+                        ? static_cast<int64_t>(std::visit(
+                              VariantToUnsignedIntVisitor(), found->second))
+                        : static_cast<int64_t>(
+                              std::visit(VariantToIntVisitor(), found->second));
+                index.objects[converted].push_back(idx);
+            }
+        }
+        catch (std::invalid_argument&)
+        {
+            // leave it to the linear match
+            index.usable = false;
+            index.objects.clear();
+        }
+    }
+    if (!findIndex->second.usable)
+    {
+        return std::nullopt;
+    }
+
+    std::vector<size_t> result;
+    for (int64_t key : keys)
+    {
+        auto found = findIndex->second.objects.find(key);
+        if (found != findIndex->second.objects.end())
+        {
+            result.insert(result.end(), found->second.begin(),
+                          found->second.end());
+        }
+    }
+    if (keys.size() > 1)
+    {
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+    return result;
+}
+
+// probes dbus interface dictionary for a key with a value that matches a regex
+bool probeDbus(
+    const std::string& interface,
+    const std::map<std::string, nlohmann::json>& matches,
+    std::vector<std::optional<DBusProperties>>& devices,
+    bool& foundProbe)
+{
+    std::vector<DBusProperties>& dbusObject = DBUS_PROBE_OBJECTS[interface];
+    if (dbusObject.empty())
+    {
+        foundProbe = false;
+        return false;
+    }
+    foundProbe = true;
+
+    // many configurations probe with the same terms, and the objects only
+    // change between scans
+    auto& cache = probeCache[interface];
+    std::string cacheKey = nlohmann::json(matches).dump();
+    auto cached = cache.find(cacheKey);
+    if (cached != cache.end())
+    {
+        for (size_t idx : cached->second)
+        {
+            devices.emplace_back(dbusObject[idx]);
+        }
+        return !cached->second.empty();
+    }
+    std::vector<size_t>& matched = cache[cacheKey];
+
+    // equality matches narrow the objects down through an index, only what is
+    // left is checked against every match
+    std::optional<std::vector<size_t>> candidates;
+    for (auto& match : matches)
+    {
+        std::optional<std::vector<size_t>> indexed =
+            indexedObjects(interface, dbusObject, match.first, match.second);
+        if (!indexed)
+        {
+            continue;
+        }
+        if (!candidates)
+        {
+            candidates = std::move(indexed);
+        }
+        else
+        {
+            std::vector<size_t> both;
+            std::set_intersection(candidates->begin(), candidates->end(),
+                                  indexed->begin(), indexed->end(),
+                                  std::back_inserter(both));
+            candidates = std::move(both);
+        }
+        if (candidates->empty())
+        {
+            return false;
+        }
+    }
+
+    // regexes and comparisons are compiled once per term, not per object. A
+    // pattern without regex syntax is searched for as is
+    const static std::string regexSyntax = R"(\^$.|?*+()[]{})";
+    std::vector<std::optional<std::regex>> patterns;
+    std::vector<const std::optional<std::vector<ProbeComparison>>*>
+        comparisons;
+    std::vector<std::optional<InternedString>> names;
+    for (auto& match : matches)
+    {
+        std::optional<std::regex> pattern;
+        const std::optional<std::vector<ProbeComparison>>* comparison =
+            nullptr;
+        if (match.second.type() == nlohmann::json::value_t::string)
+        {
+            const std::string& str =
+                match.second.get_ref<const std::string&>();
+            if (str.find_first_of(regexSyntax) != std::string::npos)
+            {
+                pattern.emplace(str);
+            }
+        }
+        else if (match.second.type() == nlohmann::json::value_t::object)
+        {
+            comparison = &compiledComparison(match.second);
+        }
+        patterns.emplace_back(std::move(pattern));
+        comparisons.push_back(comparison);
+        names.emplace_back(InternedString::find(match.first));
+    }
+
+    VariantToStringViewVisitor toStringView;
+    bool foundMatch = false;
+    size_t count = candidates ? candidates->size() : dbusObject.size();
+    for (size_t ii = 0; ii < count; ii++)
+    {
+        size_t idx = candidates ? (*candidates)[ii] : ii;
+        auto& device = dbusObject[idx];
+        bool deviceMatches = true;
+        size_t matchIdx = 0;
+        for (auto matchIt = matches.begin(); matchIt != matches.end();
+             matchIt++, matchIdx++)
+        {
+            auto& match = *matchIt;
+            const std::optional<InternedString>& name = names[matchIdx];
+            auto deviceValue = name ? device.find(*name) : device.end();
+            if (deviceValue != device.end())
+            {
+                switch (match.second.type())
+                {
+                    case nlohmann::json::value_t::string:
+                    {
+                        // view of the value as a string, no copies
+                        std::string_view probeValue =
+                            std::visit(toStringView, deviceValue->second);
+                        const std::optional<std::regex>& search =
+                            patterns[matchIdx];
+                        if (search)
+                        {
+                            std::cmatch regMatch;
+                            if (!std::regex_search(
+                                    probeValue.data(),
+                                    probeValue.data() + probeValue.size(),
+                                    regMatch, *search))
+                            {
+                                deviceMatches = false;
+                            }
+                        }
+                        else if (probeValue.find(match.second.get_ref<
+                                                 const std::string&>()) ==
+                                 std::string_view::npos)
+                        {
+                            deviceMatches = false;
+                        }
+                        break;
+                    }
+                    case nlohmann::json::value_t::boolean:
+                    case nlohmann::json::value_t::number_unsigned:
+                    {
+                        unsigned int probeValue = std::visit(
+                            VariantToUnsignedIntVisitor(), deviceValue->second);
+
+                        if (probeValue != match.second.get<unsigned int>())
+                        {
+                            deviceMatches = false;
+                        }
+                        break;
+                    }
+                    case nlohmann::json::value_t::number_integer:
+                    {
+                        int probeValue = std::visit(VariantToIntVisitor(),
+                                                    deviceValue->second);
+
+                        if (probeValue != match.second.get<int>())
+                        {
+                            deviceMatches = false;
+                        }
+                        break;
+                    }
+                    case nlohmann::json::value_t::number_float:
+                    {
+                        float probeValue = std::visit(VariantToFloatVisitor(),
+                                                      deviceValue->second);
+
+                        if (probeValue != match.second.get<float>())
+                        {
+                            deviceMatches = false;
+                        }
+                        break;
+                    }
+                    case nlohmann::json::value_t::object:
+                    {
+                        const auto& compiled = *comparisons[matchIdx];
+                        if (!compiled ||
+                            !compareProbeValue(*compiled, deviceValue->second))
+                        {
+                            deviceMatches = false;
+                        }
+                        break;
+                    }
+                    default:
+                    {
+                        std::cerr << "unexpected dbus probe type "
+                                  << match.second.type_name() << "\n";
+                    }
+                }
+            }
+            else
+            {
+                deviceMatches = false;
+                break;
+            }
+        }
+        if (deviceMatches)
+        {
+            devices.emplace_back(device);
+            matched.push_back(idx);
+            foundMatch = true;
+            deviceMatches = false; // for next iteration
+        }
+    }
+    return foundMatch;
+}
+
+void probeObjectsChanged(const std::string& interface)
+{
+    probeCache.erase(interface);
+    propertyIndexes.erase(interface);
+}
+
+// every interface is fetched again, the cached results stay until the objects
+// turn out to have changed, see finishDbusObjects
+static void clearProbeObjects(void)
+{
+    for (auto& [interface, objects] : DBUS_PROBE_OBJECTS)
+    {
+        previousProbeObjects[interface] = std::move(objects);
+    }
+    DBUS_PROBE_OBJECTS.clear();
+}
+
+static boost::container::flat_map<const char*, probe_type_codes,
+                                  cmp_str>::const_iterator
+    findProbeType(const std::string& probe)
+{
+    boost::container::flat_map<const char*, probe_type_codes,
+                               cmp_str>::const_iterator probeType;
+    for (probeType = PROBE_TYPES.begin(); probeType != PROBE_TYPES.end();
+         probeType++)
+    {
+        if (probe.find(probeType->first) != std::string::npos)
+        {
+            break;
+        }
+    }
+    return probeType;
+}
+
+// splits a dbus probe term such as xyz.openbmc_project.FruDevice({'BUS': 1})
+// into its interface and property matches
+static bool parseDbusProbe(const std::string& probe, std::string& interface,
+                           std::map<std::string, nlohmann::json>& matches)
+{
+    const static std::regex command(R"(\((.*)\))");
+    std::smatch match;
+    if (!std::regex_search(probe, match, command))
+    {
+        std::cerr << "dbus probe syntax error " << probe << "\n";
+        return false;
+    }
+    std::string commandStr = *(match.begin() + 1);
+    // convert single ticks and single slashes into legal json
+    boost::replace_all(commandStr, "'", "\"");
+    boost::replace_all(commandStr, R"(\)", R"(\\)");
+    auto json = nlohmann::json::parse(commandStr, nullptr, false);
+    if (json.is_discarded())
+    {
+        std::cerr << "dbus command syntax error " << commandStr << "\n";
+        return false;
+    }
+    // we can match any (string, variant) property. (string, string) does a
+    // regex
+    matches = json.get<std::map<std::string, nlohmann::json>>();
+    auto findStart = probe.find("(");
+    if (findStart == std::string::npos)
+    {
+        return false;
+    }
+    interface = probe.substr(0, findStart);
+    return true;
+}
+
+// compiles the comparisons of a configuration's probe up front, so scans only
+// look them up
+static void compileProbeComparisons(const nlohmann::json& configuration)
+{
+    auto findProbe = configuration.find("Probe");
+    if (findProbe == configuration.end())
+    {
+        return;
+    }
+    std::vector<const nlohmann::json*> terms;
+    if (findProbe->type() == nlohmann::json::value_t::array)
+    {
+        for (const auto& term : *findProbe)
+        {
+            terms.push_back(&term);
+        }
+    }
+    else
+    {
+        terms.push_back(&*findProbe);
+    }
+    for (const nlohmann::json* term : terms)
+    {
+        const std::string* probe = term->get_ptr<const std::string*>();
+        if (probe == nullptr || findProbeType(*probe) != PROBE_TYPES.end())
+        {
+            continue;
+        }
+        std::string interface;
+        std::map<std::string, nlohmann::json> matches;
+        if (!parseDbusProbe(*probe, interface, matches))
+        {
+            continue;
+        }
+        for (const auto& match : matches)
+        {
+            if (match.second.type() == nlohmann::json::value_t::object)
+            {
+                compiledComparison(match.second);
+            }
+        }
+    }
+}
+
+// once the result is false and no OR follows, nothing can make it true again
+static bool probeDecided(const ProbeState& state,
+                         const std::vector<std::string>& probeCommand)
+{
+    if (state.first || state.ret)
+    {
+        return false;
+    }
+    for (size_t ii = state.index; ii < probeCommand.size(); ii++)
+    {
+        auto probeType = findProbeType(probeCommand[ii]);
+        if (probeType != PROBE_TYPES.end() &&
+            probeType->second == probe_type_codes::OR)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// evaluates from state.index on. available is asked before each dbus term,
+// when it returns false nullopt is returned and the same state can be
+// evaluated again later
+static std::optional<bool>
+    evaluateProbe(const std::vector<std::string>& probeCommand,
+                  ProbeState& state,
+                  const std::function<bool(const std::string&)>& available)
+{
+    const static std::regex command(R"(\((.*)\))");
+    std::smatch match;
+
+    for (; state.index < probeCommand.size(); state.index++)
+    {
+        const std::string& probe = probeCommand[state.index];
+        if (probeDecided(state, probeCommand))
+        {
+            return false;
+        }
+
+        bool foundProbe = false;
+        auto probeType = findProbeType(probe);
+        if (probeType != PROBE_TYPES.end())
+        {
+            switch (probeType->second)
+            {
+                case probe_type_codes::FALSE_T:
+                {
+                    state.cur = false;
+                    break;
+                }
+                case probe_type_codes::TRUE_T:
+                {
+                    state.cur = true;
+                    break;
+                }
+                case probe_type_codes::MATCH_ONE:
+                {
+                    // set current value to last, this probe type shouldn't
+                    // affect the outcome
+                    state.cur = state.ret;
+                    state.matchOne = true;
+                    break;
+                }
+                /*case probe_type_codes::AND:
+                  break;
+                case probe_type_codes::OR:
+                  break;
+                  // these are no-ops until the last command switch
+                  */
+                case probe_type_codes::FOUND:
+                {
+                    if (!std::regex_search(probe, match, command))
+                    {
+                        std::cerr << "found probe syntax error " << probe
+                                  << "\n";
+                        return false;
+                    }
+                    std::string commandStr = *(match.begin() + 1);
+                    boost::replace_all(commandStr, "'", "");
+                    state.cur =
+                        (std::find(PASSED_PROBES.begin(), PASSED_PROBES.end(),
+                                   commandStr) != PASSED_PROBES.end());
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+        }
+        // look on dbus for object
+        else
+        {
+            std::string probeInterface;
+            std::map<std::string, nlohmann::json> dbusProbeMap;
+            if (!parseDbusProbe(probe, probeInterface, dbusProbeMap))
+            {
+                return false;
+            }
+            if (!available(probeInterface))
+            {
+                // continue from this term once the objects are there
+                return std::nullopt;
+            }
+            state.cur = probeDbus(probeInterface, dbusProbeMap,
+                                  state.foundDevs, foundProbe);
+        }
+
+        // some functions like AND and OR only take affect after the
+        // fact
+        if (state.lastCommand == probe_type_codes::AND)
+        {
+            state.ret = state.cur && state.ret;
+        }
+        else if (state.lastCommand == probe_type_codes::OR)
+        {
+            state.ret = state.cur || state.ret;
+        }
+
+        if (state.first)
+        {
+            state.ret = state.cur;
+            state.first = false;
+        }
+        state.lastCommand = probeType != PROBE_TYPES.end()
+                                ? probeType->second
+                                : probe_type_codes::FALSE_T;
+    }
+
+    // probe passed, but empty device
+    if (state.ret && state.foundDevs.size() == 0)
+    {
+        state.foundDevs.emplace_back(std::nullopt);
+    }
+    if (state.matchOne && state.ret)
+    {
+        // match the last one
+        auto last = state.foundDevs.back();
+        state.foundDevs.clear();
+
+        state.foundDevs.emplace_back(std::move(last));
+    }
+    return state.ret;
+}
+
+// default probe entry point, iterates a list looking for specific types to
+// call specific probe functions
+bool probe(
+    const std::vector<std::string>& probeCommand,
+    std::vector<std::optional<DBusProperties>>& foundDevs)
+{
+    ProbeState state;
+    // everything is expected to be in DBUS_PROBE_OBJECTS already
+    bool ret = *evaluateProbe(probeCommand, state,
+                              [](const std::string&) { return true; });
+    foundDevs = std::move(state.foundDevs);
+    return ret;
+}
+
+// this class runs a probe, fetching the dbus objects of each term only when
+// the term is reached. It is kept alive by pendingProbes while it waits
+struct PerformProbe : std::enable_shared_from_this<PerformProbe>
+{
+
+    PerformProbe(
+        const std::vector<std::string>& probeCommand,
+        std::function<void(std::vector<std::optional<DBusProperties>>&)>&&
+            callback) :
+        _probeCommand(probeCommand),
+        _callback(std::move(callback))
+    {
+    }
+    void run()
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::optional<bool> passed = evaluateProbe(
+            _probeCommand, _state, [this](const std::string& interface) {
+                return findDbusObjects(shared_from_this(), SYSTEM_BUS,
+                                       interface);
+            });
+        scanStatistics.accumulate(ScanPhase::probeEvaluation,
+                                  std::chrono::steady_clock::now() - start);
+        if (passed && *passed)
+        {
+            _callback(_state.foundDevs);
+        }
     }
     std::vector<std::string> _probeCommand;
-    std::function<void(std::vector<std::optional<boost::container::flat_map<
-                           std::string, BasicVariantType>>>&)>
+    std::function<void(std::vector<std::optional<DBusProperties>>&)>
         _callback;
+    ProbeState _state;
 };
 
+static void finishDbusObjects(const std::string& interface,
+                              std::vector<DBusProperties>&& objects)
+{
+    bool unchanged = false;
+    auto previous = previousProbeObjects.find(interface);
+    if (previous != previousProbeObjects.end())
+    {
+        unchanged = previous->second == objects;
+        previousProbeObjects.erase(previous);
+    }
+    DBUS_PROBE_OBJECTS[interface] = std::move(objects);
+    if (!unchanged)
+    {
+        probeObjectsChanged(interface);
+    }
+
+    std::vector<std::shared_ptr<PerformProbe>> waiting;
+    waiting.swap(pendingProbes[interface]);
+    for (const auto& probe : waiting)
+    {
+        probe->run();
+    }
+}
+
+std::shared_ptr<sdbusplus::asio::dbus_interface>
+    createInterface(sdbusplus::asio::object_server& objServer,
+                    const std::string& path, const std::string& interface,
+                    const std::string& parent)
+{
+    auto iface = objServer.add_interface(path, interface);
+    inventory[parent].emplace_back(iface);
+    return iface;
+}
+
 // writes output files to persist data
 bool writeJsonFiles(const nlohmann::json& systemConfiguration)
 {
@@ -838,15 +1642,17 @@ sdbusplus::asio::PropertyPermission getPermission(const std::string& interface)
 void createAddObjectMethod(const std::string& jsonPointerPath,
                            const std::string& path,
                            nlohmann::json& systemConfiguration,
-                           sdbusplus::asio::object_server& objServer)
+                           sdbusplus::asio::object_server& objServer,
+                           const std::string& board)
 {
-    auto iface = objServer.add_interface(path, "xyz.openbmc_project.AddObject");
+    auto iface = createInterface(objServer, path,
+                                 "xyz.openbmc_project.AddObject", board);
 
     iface->register_method(
         "AddObject",
         [&systemConfiguration, &objServer,
          jsonPointerPath{std::string(jsonPointerPath)},
-         path{std::string(path)}](
+         path{std::string(path)}, board{std::string(board)}](
             const boost::container::flat_map<std::string, JsonVariantType>&
                 data) {
             nlohmann::json::json_pointer ptr(jsonPointerPath);
@@ -925,9 +1731,9 @@ void createAddObjectMethod(const std::string& jsonPointerPath,
 
             std::regex_replace(dbusName.begin(), dbusName.begin(),
                                dbusName.end(), ILLEGAL_DBUS_MEMBER_REGEX, "_");
-            auto interface = objServer.add_interface(
-                path + "/" + dbusName,
-                "xyz.openbmc_project.Configuration." + *type);
+            auto interface = createInterface(
+                objServer, path + "/" + dbusName,
+                "xyz.openbmc_project.Configuration." + *type, board);
             // permission is read-write, as since we just created it, must be
             // runtime modifiable
             populateInterfaceFromJson(
@@ -948,6 +1754,7 @@ void postToDbus(const nlohmann::json& newConfiguration,
     for (auto& boardPair : newConfiguration.items())
     {
         std::string boardKey = boardPair.value()["Name"];
+        const std::string& boardKeyOrig = boardPair.key();
         std::string jsonPointerPath = "/" + boardPair.key();
         // loop through newConfiguration, but use values from system
         // configuration to be able to modify via dbus later
@@ -974,14 +1781,16 @@ void postToDbus(const nlohmann::json& newConfiguration,
         std::string boardName = "/xyz/openbmc_project/inventory/system/" +
                                 boardtypeLower + "/" + boardKey;
 
-        auto inventoryIface = objServer.add_interface(
-            boardName, "xyz.openbmc_project.Inventory.Item");
+        auto inventoryIface =
+            createInterface(objServer, boardName,
+                            "xyz.openbmc_project.Inventory.Item", boardKeyOrig);
 
-        auto boardIface = objServer.add_interface(
-            boardName, "xyz.openbmc_project.Inventory.Item." + boardType);
+        auto boardIface = createInterface(
+            objServer, boardName,
+            "xyz.openbmc_project.Inventory.Item." + boardType, boardKeyOrig);
 
         createAddObjectMethod(jsonPointerPath, boardName, systemConfiguration,
-                              objServer);
+                              objServer, boardKeyOrig);
 
         populateInterfaceFromJson(systemConfiguration, jsonPointerPath,
                                   boardIface, boardValues, objServer);
@@ -991,8 +1800,8 @@ void postToDbus(const nlohmann::json& newConfiguration,
         {
             if (boardField.value().type() == nlohmann::json::value_t::object)
             {
-                auto iface =
-                    objServer.add_interface(boardName, boardField.key());
+                auto iface = createInterface(objServer, boardName,
+                                             boardField.key(), boardKeyOrig);
                 populateInterfaceFromJson(systemConfiguration,
                                           jsonPointerPath + boardField.key(),
                                           iface, boardField.value(), objServer);
@@ -1048,9 +1857,9 @@ void postToDbus(const nlohmann::json& newConfiguration,
             std::regex_replace(itemName.begin(), itemName.begin(),
                                itemName.end(), ILLEGAL_DBUS_MEMBER_REGEX, "_");
 
-            auto itemIface = objServer.add_interface(
-                boardName + "/" + itemName,
-                "xyz.openbmc_project.Configuration." + itemType);
+            auto itemIface = createInterface(
+                objServer, boardName + "/" + itemName,
+                "xyz.openbmc_project.Configuration." + itemType, boardKeyOrig);
 
             populateInterfaceFromJson(systemConfiguration, jsonPointerPath,
                                       itemIface, item, objServer,
@@ -1064,10 +1873,11 @@ void postToDbus(const nlohmann::json& newConfiguration,
                 if (objectPair.value().type() ==
                     nlohmann::json::value_t::object)
                 {
-                    auto objectIface = objServer.add_interface(
-                        boardName + "/" + itemName,
+                    auto objectIface = createInterface(
+                        objServer, boardName + "/" + itemName,
                         "xyz.openbmc_project.Configuration." + itemType + "." +
-                            objectPair.key());
+                            objectPair.key(),
+                        boardKeyOrig);
 
                     populateInterfaceFromJson(
                         systemConfiguration, jsonPointerPath, objectIface,
@@ -1107,10 +1917,11 @@ void postToDbus(const nlohmann::json& newConfiguration,
                     for (auto& arrayItem : objectPair.value())
                     {
 
-                        auto objectIface = objServer.add_interface(
-                            boardName + "/" + itemName,
+                        auto objectIface = createInterface(
+                            objServer, boardName + "/" + itemName,
                             "xyz.openbmc_project.Configuration." + itemType +
-                                "." + objectPair.key() + std::to_string(index));
+                                "." + objectPair.key() + std::to_string(index),
+                            boardKeyOrig);
                         populateInterfaceFromJson(
                             systemConfiguration,
                             jsonPointerPath + "/" + std::to_string(index),
@@ -1129,8 +1940,7 @@ void postToDbus(const nlohmann::json& newConfiguration,
 // ADDRESS field from a object on dbus
 void templateCharReplace(
     nlohmann::json::iterator& keyPair,
-    const boost::container::flat_map<std::string, BasicVariantType>&
-        foundDevice,
+    const DBusProperties& foundDevice,
     size_t& foundDeviceIdx)
 {
     if (keyPair.value().type() == nlohmann::json::value_t::object ||
@@ -1155,7 +1965,7 @@ void templateCharReplace(
 
     for (auto& foundDevicePair : foundDevice)
     {
-        std::string templateName = templateChar + foundDevicePair.first;
+        std::string templateName = templateChar + foundDevicePair.first.str();
         boost::iterator_range<std::string::const_iterator> find =
             boost::ifind_first(*strPtr, templateName);
         if (find)
@@ -1339,20 +2149,19 @@ void templateCharReplace(
 }
 
 // reads json files out of the filesystem
-bool findJsonFiles(std::list<nlohmann::json>& configurations)
+bool findJsonFiles(std::list<nlohmann::json>& configurations,
+                   const std::filesystem::path& configurationDir)
 {
     // find configuration files
     std::vector<std::filesystem::path> jsonPaths;
-    if (!findFiles(std::filesystem::path(configurationDirectory), R"(.*\.json)",
-                   jsonPaths))
+    if (!findFiles(configurationDir, R"(.*\.json)", jsonPaths))
     {
         std::cerr << "Unable to find any configuration files in "
-                  << configurationDirectory << "\n";
+                  << configurationDir << "\n";
         return false;
     }
 
-    std::ifstream schemaStream(std::string(schemaDirectory) + "/" +
-                               globalSchema);
+    std::ifstream schemaStream(configurationDir / "schemas" / globalSchema);
     if (!schemaStream.good())
     {
         std::cerr
@@ -1395,26 +2204,136 @@ bool findJsonFiles(std::list<nlohmann::json>& configurations)
 
         if (data.type() == nlohmann::json::value_t::array)
         {
-            for (auto& d : data)
-            {
-                configurations.emplace_back(d);
-            }
+            for (auto& d : data)
+            {
+                compileProbeComparisons(d);
+                configurations.emplace_back(d);
+            }
+        }
+        else
+        {
+            compileProbeComparisons(data);
+            configurations.emplace_back(data);
+        }
+    }
+    return true;
+}
+
+static bool scanPowerState(void)
+{
+    if (capturedPowerState)
+    {
+        return *capturedPowerState;
+    }
+    return isPowerOn();
+}
+
+// records found by a scan are filled in here, created with the first scan
+static std::unique_ptr<ScanWorkers> scanWorkers;
+
+static size_t scanWorkerCount(void)
+{
+    return std::max(1U, std::thread::hardware_concurrency());
+}
+
+// runs work on the scan workers when there are some, done always runs on the
+// io thread and is told whether the work threw
+static void runScanWork(std::function<void(void)>&& work,
+                        std::function<void(bool failed)>&& done)
+{
+    if (!scanWorkers)
+    {
+        bool failed = false;
+        try
+        {
+            work();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "scan work failed: " << e.what() << "\n";
+            failed = true;
+        }
+        done(failed);
+        return;
+    }
+    scanWorkers->post(std::move(work), std::move(done));
+}
+
+// a record found by a probe, filled in on a scan worker and stored on the io
+// thread once every record found before it has been stored. Only filling is
+// handed to the workers: probes read the dbus objects, the probe cache and
+// PASSED_PROBES, which the io thread changes as objects come and go, and binds
+// resolve against every record stored before them, so both stay on the io
+// thread where they need no locking.
+struct PendingRecord
+{
+    std::string name;
+    // as written in the configuration file, owned by the scan
+    const nlohmann::json* record = nullptr;
+    // with the template characters replaced
+    nlohmann::json filled;
+    std::optional<DBusProperties> device;
+    size_t index = 0;
+    // the unfilled record only needs to be published while binds are
+    // resolved if one of them could refer to it
+    bool hasBinds = false;
+    std::chrono::steady_clock::duration fillTime =
+        std::chrono::steady_clock::duration::zero();
+    bool ready = false;
+    // filling threw, filled is incomplete and the record is skipped
+    bool failed = false;
+};
+
+// runs on a scan worker, only touches the record it was handed. This is the
+// only copy of the record made per device, it is moved into the system
+// configuration once binds are resolved.
+static void fillRecord(PendingRecord& pending)
+{
+    if (pending.record->find("Exposes") == pending.record->end())
+    {
+        // published as written, see storeRecord
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    nlohmann::json& record = pending.filled;
+    record = *pending.record;
+    size_t foundDeviceIdx = pending.index;
+    if (pending.device)
+    {
+        for (auto keyPair = record.begin(); keyPair != record.end();
+             keyPair++)
+        {
+            templateCharReplace(keyPair, *pending.device, foundDeviceIdx);
         }
-        else
+    }
+    for (auto& expose : record["Exposes"])
+    {
+        for (auto keyPair = expose.begin(); keyPair != expose.end();
+             keyPair++)
         {
-            configurations.emplace_back(data);
+            if (pending.device)
+            {
+                templateCharReplace(keyPair, *pending.device,
+                                    foundDeviceIdx);
+            }
+            if (boost::starts_with(keyPair.key(), "Bind"))
+            {
+                pending.hasBinds = true;
+            }
         }
     }
-    return true;
+    pending.fillTime = std::chrono::steady_clock::now() - start;
 }
 
 struct PerformScan : std::enable_shared_from_this<PerformScan>
 {
 
     PerformScan(nlohmann::json& systemConfiguration,
+                nlohmann::json& missingConfigurations,
                 std::list<nlohmann::json>& configurations,
                 std::function<void(void)>&& callback) :
         _systemConfiguration(systemConfiguration),
+        _missingConfigurations(missingConfigurations),
         _configurations(configurations), _callback(std::move(callback))
     {
     }
@@ -1467,17 +2386,28 @@ struct PerformScan : std::enable_shared_from_this<PerformScan>
             auto p = std::make_shared<PerformProbe>(
                 probeCommand,
                 [&, recordPtr, probeName,
-                 thisRef](std::vector<std::optional<boost::container::flat_map<
-                              std::string, BasicVariantType>>>& foundDevices) {
+                 thisRef](std::vector<std::optional<DBusProperties>>&
+                              foundDevices) {
                     _passed = true;
 
                     PASSED_PROBES.push_back(probeName);
-                    size_t foundDeviceIdx = 0;
+                    // the index is the position of the device, as a scan
+                    // that finds them all at once would number them. Records
+                    // that are already published keep theirs, so new ones
+                    // mustn't be numbered from 0 again
+                    bool indexed =
+                        recordPtr->find("Exposes") != recordPtr->end();
+                    size_t nextDeviceIdx = 0;
 
                     for (auto& foundDevice : foundDevices)
                     {
-                        nlohmann::json record = *recordPtr;
-                        std::string recordName;
+                        size_t foundDeviceIdx = nextDeviceIdx;
+                        if (indexed)
+                        {
+                            nextDeviceIdx++;
+                        }
+                        auto pending = std::make_shared<PendingRecord>();
+                        std::string& recordName = pending->name;
                         size_t hash = 0;
                         if (foundDevice)
                         {
@@ -1510,213 +2440,977 @@ struct PerformScan : std::enable_shared_from_this<PerformScan>
                         {
                             recordName = probeName;
                         }
-
-                        auto fromLastJson = lastJson.find(recordName);
-                        if (fromLastJson != lastJson.end())
+                        _pendingRecords.push_back(pending);
+
+                        // records that are already published, kept from the
+                        // last boot or found earlier in this pass are not
+                        // filled in
+                        bool filled =
+                            _systemConfiguration.find(recordName) ==
+                                _systemConfiguration.end() &&
+                            lastJson.find(recordName) == lastJson.end() &&
+                            _queuedNames.insert(recordName).second;
+                        if (!filled)
                         {
-                            // keep user changes
-                            _systemConfiguration[recordName] = *fromLastJson;
+                            pending->ready = true;
                             continue;
                         }
 
-                        // insert into configuration temporarily to be able to
-                        // reference ourselves
+                        pending->record = recordPtr;
+                        pending->device = foundDevice;
+                        pending->index = foundDeviceIdx;
+                        runScanWork([pending]() { fillRecord(*pending); },
+                                    [this, thisRef, pending](bool failed) {
+                                        pending->failed = failed;
+                                        pending->ready = true;
+                                        storeRecords();
+                                    });
+                    }
+                    storeRecords();
+                });
+            p->run();
+            it++;
+        }
+    }
+
+    ~PerformScan()
+    {
+        if (_passed)
+        {
+            auto nextScan = std::make_shared<PerformScan>(
+                _systemConfiguration, _missingConfigurations, _configurations,
+                std::move(_callback));
+            nextScan->run();
+        }
+        else
+        {
+            _callback();
+        }
+    }
+
+    // records are stored in the order they were found, whichever worker
+    // finishes first, so binds see the same configuration as they would if
+    // every record was filled in on the io thread
+    void storeRecords(void)
+    {
+        while (!_pendingRecords.empty() && _pendingRecords.front()->ready)
+        {
+            auto start = std::chrono::steady_clock::now();
+            PendingRecord& pending = *_pendingRecords.front();
+            if (pending.failed)
+            {
+                std::cerr << "unable to fill in " << pending.name
+                          << ", skipping it\n";
+            }
+            else
+            {
+                storeRecord(pending);
+            }
+            // worker time is summed, with several workers it can exceed the
+            // time the scan took
+            scanStatistics.accumulate(ScanPhase::templating,
+                                      pending.fillTime +
+                                          std::chrono::steady_clock::now() -
+                                          start);
+            _pendingRecords.pop_front();
+        }
+    }
+
+    void storeRecord(PendingRecord& pending)
+    {
+        const std::string& recordName = pending.name;
+        _missingConfigurations.erase(recordName);
+
+        if (_systemConfiguration.find(recordName) !=
+            _systemConfiguration.end())
+        {
+            // already published, keep changes made since
+            return;
+        }
+
+        auto fromLastJson = lastJson.find(recordName);
+        if (fromLastJson != lastJson.end())
+        {
+            // keep user changes
+            _systemConfiguration[recordName] = *fromLastJson;
+            return;
+        }
+
+        if (pending.record->find("Exposes") == pending.record->end())
+        {
+            // nothing to fill in or bind
+            _systemConfiguration[recordName] = *pending.record;
+            return;
+        }
+        nlohmann::json& record = pending.filled;
+        auto findExpose = record.find("Exposes");
+        if (pending.hasBinds)
+        {
+            // insert into configuration temporarily to be able to reference
+            // ourselves
+            _systemConfiguration[recordName] = *pending.record;
+        }
+        for (auto& expose : *findExpose)
+        {
+            for (auto keyPair = expose.begin(); keyPair != expose.end();
+                 keyPair++)
+            {
+                // special case bind
+                if (!boost::starts_with(keyPair.key(), "Bind"))
+                {
+                    continue;
+                }
+                if (keyPair.value().type() != nlohmann::json::value_t::string)
+                {
+                    std::cerr << "bind_ value must be of type string "
+                              << keyPair.key() << "\n";
+                    continue;
+                }
+                bool foundBind = false;
+                std::string bind = keyPair.key().substr(sizeof("Bind") - 1);
+
+                for (auto& configurationPair : _systemConfiguration.items())
+                {
+
+                    auto configListFind =
+                        configurationPair.value().find("Exposes");
+
+                    if (configListFind == configurationPair.value().end() ||
+                        configListFind->type() !=
+                            nlohmann::json::value_t::array)
+                    {
+                        continue;
+                    }
+                    for (auto& exposedObject : *configListFind)
+                    {
+                        std::string foundObjectName = (exposedObject)["Name"];
+                        if (boost::iequals(
+                                foundObjectName,
+                                keyPair.value().get<std::string>()))
+                        {
+                            exposedObject["Status"] = "okay";
+                            expose[bind] = exposedObject;
+
+                            foundBind = true;
+                            break;
+                        }
+                    }
+                    if (foundBind)
+                    {
+                        break;
+                    }
+                }
+                if (!foundBind)
+                {
+                    std::cerr << "configuration file dependency error, "
+                                 "could not find bind "
+                              << keyPair.value() << "\n";
+                }
+            }
+        }
+        // a replay is not a real inventory change
+        if (SYSTEM_BUS)
+        {
+            logDeviceAdded(record);
+        }
+
+        // overwrite ourselves with cleaned up version
+        _systemConfiguration[recordName] = std::move(record);
+    }
+
+    nlohmann::json& _systemConfiguration;
+    // records that existed before the scan and haven't been found again yet
+    nlohmann::json& _missingConfigurations;
+    std::list<nlohmann::json> _configurations;
+    std::deque<std::shared_ptr<PendingRecord>> _pendingRecords;
+    // names queued to be filled in by this pass
+    boost::container::flat_set<std::string> _queuedNames;
+    std::function<void(void)> _callback;
+    std::vector<std::shared_ptr<PerformProbe>> _probes;
+    bool _passed = false;
+    bool powerWasOn = scanPowerState();
+};
+
+static std::vector<std::string> probeTerms(const nlohmann::json& record)
+{
+    std::vector<std::string> terms;
+    auto findProbe = record.find("Probe");
+    if (findProbe == record.end())
+    {
+        return terms;
+    }
+    if (findProbe->type() != nlohmann::json::value_t::array)
+    {
+        const std::string* term = findProbe->get_ptr<const std::string*>();
+        if (term != nullptr)
+        {
+            terms.push_back(*term);
+        }
+        return terms;
+    }
+    for (const auto& term : *findProbe)
+    {
+        const std::string* ptr = term.get_ptr<const std::string*>();
+        if (ptr != nullptr)
+        {
+            terms.push_back(*ptr);
+        }
+    }
+    return terms;
+}
+
+// the power state a record needs: its own PowerState when it has one,
+// otherwise the latest one any of its exposes needs, BiosPost after On
+static std::string recordPowerState(const nlohmann::json& record)
+{
+    auto powerStateOf = [](const nlohmann::json& object) -> const std::string* {
+        auto powerState = object.find("PowerState");
+        if (powerState == object.end())
+        {
+            return nullptr;
+        }
+        return powerState->get_ptr<const std::string*>();
+    };
+    const std::string* own = powerStateOf(record);
+    if (own != nullptr)
+    {
+        return *own;
+    }
+    std::string powerState = "Always";
+    auto findExposes = record.find("Exposes");
+    if (findExposes == record.end() ||
+        findExposes->type() != nlohmann::json::value_t::array)
+    {
+        return powerState;
+    }
+    for (const auto& expose : *findExposes)
+    {
+        const std::string* exposed = powerStateOf(expose);
+        if (exposed == nullptr)
+        {
+            continue;
+        }
+        if (*exposed == "BiosPost")
+        {
+            return *exposed;
+        }
+        if (*exposed == "On")
+        {
+            powerState = *exposed;
+        }
+    }
+    return powerState;
+}
+
+// a record depends on power if its power state isn't Always, or if it is only
+// found when a configuration that depends on power is
+static bool isPowerGated(const nlohmann::json& record,
+                         const boost::container::flat_set<std::string>& gated)
+{
+    const static std::regex found(R"(FOUND\('?([^']*)'?\))");
+    std::string powerState = recordPowerState(record);
+    if (powerState == "On" || powerState == "BiosPost")
+    {
+        return true;
+    }
+    for (const std::string& term : probeTerms(record))
+    {
+        std::smatch match;
+        if (std::regex_search(term, match, found) &&
+            gated.find(match[1]) != gated.end())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static boost::container::flat_set<std::string>
+    powerGatedConfigurations(const std::list<nlohmann::json>& configurations)
+{
+    boost::container::flat_set<std::string> gated;
+    bool added = true;
+    // FOUND() can chain, go until nothing new depends on power
+    while (added)
+    {
+        added = false;
+        for (const auto& configuration : configurations)
+        {
+            auto findName = configuration.find("Name");
+            if (findName == configuration.end() ||
+                findName->type() != nlohmann::json::value_t::string)
+            {
+                continue;
+            }
+            const std::string& name = findName->get_ref<const std::string&>();
+            if (gated.find(name) == gated.end() &&
+                isPowerGated(configuration, gated))
+            {
+                gated.insert(name);
+                added = true;
+            }
+        }
+    }
+    return gated;
+}
+
+// limits a scan to the configurations that depend on power, everything else
+// keeps its probe results and dbus objects from the last scan
+static void partitionPowerGated(
+    std::list<nlohmann::json>& configurations,
+    boost::container::flat_set<std::string>& gated)
+{
+    gated = powerGatedConfigurations(configurations);
+    for (auto it = configurations.begin(); it != configurations.end();)
+    {
+        auto findName = it->find("Name");
+        if (findName == it->end() ||
+            findName->type() != nlohmann::json::value_t::string ||
+            gated.find(findName->get<std::string>()) == gated.end())
+        {
+            it = configurations.erase(it);
+            continue;
+        }
+        for (const std::string& term : probeTerms(*it))
+        {
+            bool isCommand = false;
+            for (const auto& probeType : PROBE_TYPES)
+            {
+                if (term.find(probeType.first) != std::string::npos)
+                {
+                    isCommand = true;
+                    break;
+                }
+            }
+            if (!isCommand)
+            {
+                std::string interface = term.substr(0, term.find("("));
+                DBUS_PROBE_OBJECTS.erase(interface);
+                probeObjectsChanged(interface);
+            }
+        }
+        it++;
+    }
+    PASSED_PROBES.erase(std::remove_if(PASSED_PROBES.begin(),
+                                       PASSED_PROBES.end(),
+                                       [&gated](const std::string& name) {
+                                           return gated.find(name) !=
+                                                  gated.end();
+                                       }),
+                        PASSED_PROBES.end());
+}
+
+void publishProvisionalConfiguration(
+    nlohmann::json& systemConfiguration,
+    sdbusplus::asio::object_server& objServer,
+    const std::shared_ptr<sdbusplus::asio::dbus_interface>& entityIface)
+{
+    if (lastJson.empty())
+    {
+        return;
+    }
+
+    // overlays are held back until the scan confirms the hardware is there
+    nlohmann::json provisional = lastJson;
+    systemConfiguration = provisional;
+    postToDbus(provisional, systemConfiguration, objServer);
+
+    provisionalConfiguration = true;
+    provisionalIface = entityIface;
+    provisionalIface->set_property("Provisional", true);
+}
+
+// takes a record that was published but not found by the scan back off of dbus
+void pruneConfiguration(nlohmann::json& systemConfiguration,
+                               sdbusplus::asio::object_server& objServer,
+                               const std::string& name)
+{
+    auto findInventory = inventory.find(name);
+    if (findInventory != inventory.end())
+    {
+        for (auto& weakIface : findInventory->second)
+        {
+            auto iface = weakIface.lock();
+            if (iface)
+            {
+                objServer.remove_interface(iface);
+            }
+        }
+        inventory.erase(findInventory);
+    }
+    systemConfiguration.erase(name);
+}
+
+void loadRemovalPolicy(void)
+{
+    std::ifstream policyStream(removalPolicyPath);
+    if (!policyStream.good())
+    {
+        return; // file is optional
+    }
+    nlohmann::json data = nlohmann::json::parse(policyStream, nullptr, false);
+    if (data.is_discarded() || data.type() != nlohmann::json::value_t::object)
+    {
+        std::cerr << "syntax error in " << removalPolicyPath << "\n";
+        return;
+    }
+    auto findGrace = data.find("GracePeriodSeconds");
+    if (findGrace == data.end() ||
+        findGrace->type() != nlohmann::json::value_t::object)
+    {
+        std::cerr << removalPolicyPath << " missing GracePeriodSeconds\n";
+        return;
+    }
+    for (const auto& item : findGrace->items())
+    {
+        const uint64_t* seconds = item.value().get_ptr<const uint64_t*>();
+        if (seconds == nullptr)
+        {
+            std::cerr << "invalid grace period for " << item.key() << "\n";
+            continue;
+        }
+        removalGracePeriods[item.key()] = *seconds;
+    }
+}
+
+// called when a scan completes with the records it looked for and the ones
+// among them it didn't find again
+static void updatePendingRemovals(
+    const boost::container::flat_set<std::string>& scanned,
+    const nlohmann::json& missingConfigurations, bool powerOn)
+{
+    // anything that showed up again isn't going away, what the scan didn't
+    // look for keeps its removal
+    for (auto it = pendingRemovals.begin(); it != pendingRemovals.end();)
+    {
+        if (scanned.find(it->first) != scanned.end() &&
+            missingConfigurations.find(it->first) ==
+                missingConfigurations.end())
+        {
+            it = pendingRemovals.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (const auto& item : missingConfigurations.items())
+    {
+        std::string powerState = recordPowerState(item.value());
+        if (!powerOn && (powerState == "On" || powerState == "BiosPost"))
+        {
+            // power not on yet, don't know if it's there or not
+            pendingRemovals.erase(item.key());
+            continue;
+        }
+        if (pendingRemovals.find(item.key()) != pendingRemovals.end())
+        {
+            continue; // keep the original deadline
+        }
+        auto findGrace = removalGracePeriods.find(powerState);
+        if (findGrace == removalGracePeriods.end())
+        {
+            findGrace = removalGracePeriods.find("Always");
+        }
+        uint64_t grace =
+            findGrace != removalGracePeriods.end() ? findGrace->second : 0;
+        pendingRemovals[item.key()] =
+            now + std::chrono::seconds(static_cast<int64_t>(grace));
+    }
+}
+
+// takes down everything that was created for a record whose probe stopped
+// matching
+static void removeConfiguration(nlohmann::json& systemConfiguration,
+                                sdbusplus::asio::object_server& objServer,
+                                const std::string& name)
+{
+    nlohmann::json record;
+    auto findRecord = systemConfiguration.find(name);
+    if (findRecord != systemConfiguration.end())
+    {
+        record = *findRecord;
+        nlohmann::json unload = nlohmann::json::object();
+        unload[name] = record;
+        unloadOverlays(unload);
+        pruneConfiguration(systemConfiguration, objServer, name);
+    }
+    else
+    {
+        // only known from the last boot, never published
+        auto fromLastJson = lastJson.find(name);
+        if (fromLastJson == lastJson.end())
+        {
+            return;
+        }
+        record = *fromLastJson;
+    }
+    lastJson.erase(name);
+    logDeviceRemoved(record);
+}
+
+static void startRemovalTimer(boost::asio::io_service& io,
+                              nlohmann::json& systemConfiguration,
+                              sdbusplus::asio::object_server& objServer)
+{
+    static boost::asio::deadline_timer timer(io);
+
+    if (pendingRemovals.empty())
+    {
+        timer.cancel();
+        return;
+    }
+
+    auto next = pendingRemovals.begin()->second;
+    for (const auto& pending : pendingRemovals)
+    {
+        next = std::min(next, pending.second);
+    }
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+        next - std::chrono::steady_clock::now());
+
+    timer.expires_from_now(
+        boost::posix_time::milliseconds(std::max(wait.count(), int64_t(0))));
+    timer.async_wait([&io, &systemConfiguration,
+                      &objServer](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+        {
+            // we were cancelled
+            return;
+        }
+        if (scansInProgress)
+        {
+            // the scan will restart the timer when it completes
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        bool removed = false;
+        for (auto it = pendingRemovals.begin(); it != pendingRemovals.end();)
+        {
+            if (it->second > now)
+            {
+                it++;
+                continue;
+            }
+            removeConfiguration(systemConfiguration, objServer, it->first);
+            removed = true;
+            it = pendingRemovals.erase(it);
+        }
+        if (removed && !writeJsonFiles(systemConfiguration))
+        {
+            std::cerr << "Error writing json files\n";
+        }
+        startRemovalTimer(io, systemConfiguration, objServer);
+    });
+}
 
-                        _systemConfiguration[recordName] = record;
+// heap held by a json value, not counting the value itself. Estimates assume
+// libstdc++ node sizes, the allocator's own overhead isn't included
+static size_t jsonBytes(const nlohmann::json& value)
+{
+    constexpr size_t treeNode = 4 * sizeof(void*);
+    size_t bytes = 0;
+    switch (value.type())
+    {
+        case nlohmann::json::value_t::object:
+        {
+            const auto& object =
+                value.get_ref<const nlohmann::json::object_t&>();
+            bytes += sizeof(nlohmann::json::object_t);
+            for (const auto& [key, child] : object)
+            {
+                bytes += treeNode + stringBytes(key) + sizeof(nlohmann::json) +
+                         jsonBytes(child);
+            }
+            break;
+        }
+        case nlohmann::json::value_t::array:
+        {
+            const auto& array = value.get_ref<const nlohmann::json::array_t&>();
+            bytes += sizeof(nlohmann::json::array_t) +
+                     array.capacity() * sizeof(nlohmann::json);
+            for (const auto& child : array)
+            {
+                bytes += jsonBytes(child);
+            }
+            break;
+        }
+        case nlohmann::json::value_t::string:
+        {
+            bytes += stringBytes(value.get_ref<const std::string&>());
+            break;
+        }
+        default:
+            break;
+    }
+    return bytes;
+}
 
-                        if (foundDevice)
-                        {
-                            for (auto keyPair = record.begin();
-                                 keyPair != record.end(); keyPair++)
-                            {
-                                templateCharReplace(keyPair, *foundDevice,
-                                                    foundDeviceIdx);
-                            }
-                        }
-                        auto findExpose = record.find("Exposes");
-                        if (findExpose == record.end())
-                        {
-                            continue;
-                        }
-                        for (auto& expose : *findExpose)
-                        {
-                            for (auto keyPair = expose.begin();
-                                 keyPair != expose.end(); keyPair++)
-                            {
+static size_t propertiesBytes(const DBusProperties& properties)
+{
+    size_t bytes =
+        properties.capacity() * sizeof(DBusProperties::value_type);
+    for (const auto& property : properties)
+    {
+        const std::string* str = std::get_if<std::string>(&property.second);
+        if (str != nullptr)
+        {
+            // the object itself is already counted in the map
+            bytes += stringBytes(*str) - sizeof(std::string);
+        }
+    }
+    return bytes;
+}
 
-                                // fill in template characters with devices
-                                // found
-                                if (foundDevice)
-                                {
-                                    templateCharReplace(keyPair, *foundDevice,
-                                                        foundDeviceIdx);
-                                }
-                                // special case bind
-                                if (boost::starts_with(keyPair.key(), "Bind"))
-                                {
-                                    if (keyPair.value().type() !=
-                                        nlohmann::json::value_t::string)
-                                    {
-                                        std::cerr << "bind_ value must be of "
-                                                     "type string "
-                                                  << keyPair.key() << "\n";
-                                        continue;
-                                    }
-                                    bool foundBind = false;
-                                    std::string bind = keyPair.key().substr(
-                                        sizeof("Bind") - 1);
-
-                                    for (auto& configurationPair :
-                                         _systemConfiguration.items())
-                                    {
-
-                                        auto configListFind =
-                                            configurationPair.value().find(
-                                                "Exposes");
-
-                                        if (configListFind ==
-                                                configurationPair.value()
-                                                    .end() ||
-                                            configListFind->type() !=
-                                                nlohmann::json::value_t::array)
-                                        {
-                                            continue;
-                                        }
-                                        for (auto& exposedObject :
-                                             *configListFind)
-                                        {
-                                            std::string foundObjectName =
-                                                (exposedObject)["Name"];
-                                            if (boost::iequals(
-                                                    foundObjectName,
-                                                    keyPair.value()
-                                                        .get<std::string>()))
-                                            {
-                                                exposedObject["Status"] =
-                                                    "okay";
-                                                expose[bind] = exposedObject;
-
-                                                foundBind = true;
-                                                break;
-                                            }
-                                        }
-                                        if (foundBind)
-                                        {
-                                            break;
-                                        }
-                                    }
-                                    if (!foundBind)
-                                    {
-                                        std::cerr << "configuration file "
-                                                     "dependency error, "
-                                                     "could not find bind "
-                                                  << keyPair.value() << "\n";
-                                    }
-                                }
-                            }
-                        }
-                        // overwrite ourselves with cleaned up version
-                        _systemConfiguration[recordName] = record;
+std::vector<std::tuple<std::string, uint64_t, uint64_t>> getMemoryUsage(
+    const nlohmann::json& systemConfiguration,
+    const std::vector<sdbusplus::bus::match::match>& dbusMatches)
+{
+    std::vector<std::tuple<std::string, uint64_t, uint64_t>> usage;
 
-                        logDeviceAdded(record);
+    usage.emplace_back("SystemConfiguration", jsonBytes(systemConfiguration),
+                       systemConfiguration.size());
+    usage.emplace_back("LastJson", jsonBytes(lastJson), lastJson.size());
 
-                        foundDeviceIdx++;
-                    }
-                });
-            p->run();
-            it++;
+    size_t bytes = 0;
+    size_t count = 0;
+    for (const auto& [interface, objects] : DBUS_PROBE_OBJECTS)
+    {
+        bytes += stringBytes(interface) +
+                 objects.capacity() * sizeof(DBusProperties);
+        for (const DBusProperties& object : objects)
+        {
+            bytes += propertiesBytes(object);
+        }
+        count += objects.size();
+    }
+    usage.emplace_back("ProbeObjects", bytes, count);
+    usage.emplace_back("InternedStrings", InternedString::bytes(),
+                       InternedString::count());
+
+    // results and indexes derived from the probe objects
+    bytes = 0;
+    count = 0;
+    for (const auto& [interface, cache] : probeCache)
+    {
+        bytes += stringBytes(interface);
+        for (const auto& [key, matched] : cache)
+        {
+            bytes += stringBytes(key) + matched.capacity() * sizeof(size_t);
+        }
+        count += cache.size();
+    }
+    for (const auto& [interface, indexes] : propertyIndexes)
+    {
+        bytes += stringBytes(interface);
+        for (const auto& [name, index] : indexes)
+        {
+            bytes += stringBytes(name);
+            for (const auto& [key, objects] : index.objects)
+            {
+                bytes += sizeof(key) + sizeof(objects) +
+                         objects.capacity() * sizeof(size_t);
+            }
         }
+        count += indexes.size();
     }
+    usage.emplace_back("ProbeCache", bytes, count);
 
-    ~PerformScan()
+    bytes = 0;
+    count = 0;
+    for (const auto& [interface, probes] : pendingProbes)
     {
-        if (_passed)
+        bytes += stringBytes(interface) +
+                 probes.capacity() * sizeof(std::shared_ptr<PerformProbe>);
+        for (const auto& probe : probes)
         {
-            auto nextScan = std::make_shared<PerformScan>(
-                _systemConfiguration, _configurations, std::move(_callback));
-            nextScan->run();
+            bytes += sizeof(PerformProbe);
+            for (const std::string& term : probe->_probeCommand)
+            {
+                bytes += stringBytes(term);
+            }
         }
-        else
+        count += probes.size();
+    }
+    usage.emplace_back("PendingProbes", bytes, count);
+
+    // the matches themselves live in libsystemd, only our side is counted
+    usage.emplace_back(
+        "DbusMatches",
+        dbusMatches.capacity() * sizeof(sdbusplus::bus::match::match),
+        dbusMatches.size());
+
+    // property storage is owned by sdbusplus, this is the interface objects
+    // and their bookkeeping here
+    bytes = 0;
+    count = 0;
+    for (const auto& [name, interfaces] : inventory)
+    {
+        bytes += stringBytes(name) +
+                 interfaces.capacity() *
+                     sizeof(std::weak_ptr<sdbusplus::asio::dbus_interface>);
+        for (const auto& weakIface : interfaces)
         {
-            _callback();
+            if (!weakIface.expired())
+            {
+                bytes += sizeof(sdbusplus::asio::dbus_interface);
+                count++;
+            }
         }
     }
-    nlohmann::json& _systemConfiguration;
-    std::list<nlohmann::json> _configurations;
-    std::function<void(void)> _callback;
-    std::vector<std::shared_ptr<PerformProbe>> _probes;
-    bool _passed = false;
-    bool powerWasOn = isPowerOn();
-};
+    usage.emplace_back("Interfaces", bytes, count);
+
+    return usage;
+}
+
+// bytes the property names of DBUS_PROBE_OBJECTS would take up as separate
+// strings, less what they take up interned
+static int64_t internedBytesSaved(void)
+{
+    size_t separate = 0;
+    size_t interned = 0;
+    for (const auto& [interface, objects] : DBUS_PROBE_OBJECTS)
+    {
+        for (const DBusProperties& object : objects)
+        {
+            for (const auto& property : object)
+            {
+                separate += stringBytes(property.first);
+                interned += sizeof(InternedString);
+            }
+        }
+    }
+    return static_cast<int64_t>(separate) -
+           static_cast<int64_t>(interned + InternedString::bytes());
+}
 
-void startRemovedTimer(boost::asio::deadline_timer& timer,
-                       nlohmann::json& systemConfiguration)
+void createStatisticsInterface(sdbusplus::asio::object_server& objServer)
 {
-    static bool scannedPowerOff = false;
-    static bool scannedPowerOn = false;
+    statisticsIface =
+        objServer.add_interface("/xyz/openbmc_project/EntityManager",
+                                "xyz.openbmc_project.EntityManager.Statistics");
+
+    std::vector<uint64_t> buckets(histogramBucketsUs.begin(),
+                                  histogramBucketsUs.end());
+    statisticsIface->register_property("HistogramBuckets", buckets);
 
-    if (systemConfiguration.empty() || lastJson.empty())
+    for (size_t ii = 0; ii < scanPhaseCount; ii++)
     {
-        return; // not ready yet
+        const PhaseStatistics& phase =
+            scanStatistics.phase(static_cast<ScanPhase>(ii));
+        std::string name = scanPhaseNames[ii];
+        statisticsIface->register_property(name + "Last", phase.last);
+        // UINT64_MAX until the first sample
+        statisticsIface->register_property(name + "Min", phase.min);
+        statisticsIface->register_property(name + "Max", phase.max);
+        statisticsIface->register_property(name + "Count", phase.count);
+        statisticsIface->register_property(name + "Histogram",
+                                           phase.histogram);
     }
-    if (scannedPowerOn)
+    uint64_t internedStrings = InternedString::count();
+    statisticsIface->register_property("InternedStrings", internedStrings);
+    statisticsIface->register_property("InternedBytesSaved", int64_t(0));
+    statisticsIface->initialize();
+}
+
+void updateStatisticsInterface(void)
+{
+    if (!statisticsIface)
     {
         return;
     }
+    for (size_t ii = 0; ii < scanPhaseCount; ii++)
+    {
+        const PhaseStatistics& phase =
+            scanStatistics.phase(static_cast<ScanPhase>(ii));
+        if (!phase.count)
+        {
+            continue;
+        }
+        std::string name = scanPhaseNames[ii];
+        statisticsIface->set_property(name + "Last", phase.last);
+        statisticsIface->set_property(name + "Min", phase.min);
+        statisticsIface->set_property(name + "Max", phase.max);
+        statisticsIface->set_property(name + "Count", phase.count);
+        statisticsIface->set_property(name + "Histogram", phase.histogram);
+    }
+    uint64_t internedStrings = InternedString::count();
+    statisticsIface->set_property("InternedStrings", internedStrings);
+    statisticsIface->set_property("InternedBytesSaved", internedBytesSaved());
+}
+
+// dbus signature of each BasicVariantType alternative, in index order
+static constexpr std::array<char, std::variant_size_v<BasicVariantType>>
+    variantSignatures = {'s', 'x', 't', 'd', 'i', 'u', 'n', 'q', 'y', 'b'};
+
+static nlohmann::json variantToCapture(const BasicVariantType& value)
+{
+    nlohmann::json out = nlohmann::json::array();
+    out.push_back(std::string(1, variantSignatures[value.index()]));
+    std::visit([&out](auto&& val) { out.push_back(val); }, value);
+    return out;
+}
 
-    if (!isPowerOn() && scannedPowerOff)
+// throws nlohmann::json::exception if the capture doesn't match its type
+static BasicVariantType variantFromCapture(const nlohmann::json& in)
+{
+    const std::string& type = in.at(0).get_ref<const std::string&>();
+    const nlohmann::json& value = in.at(1);
+    switch (type.empty() ? '\0' : type[0])
     {
-        return;
+        case 's':
+            return value.get<std::string>();
+        case 'x':
+            return value.get<int64_t>();
+        case 't':
+            return value.get<uint64_t>();
+        case 'd':
+            return value.get<double>();
+        case 'i':
+            return value.get<int32_t>();
+        case 'u':
+            return value.get<uint32_t>();
+        case 'n':
+            return value.get<int16_t>();
+        case 'q':
+            return value.get<uint16_t>();
+        case 'y':
+            return value.get<uint8_t>();
+        case 'b':
+            return value.get<bool>();
+        default:
+            throw std::invalid_argument("unknown capture type " + type);
     }
+}
 
-    timer.expires_from_now(boost::posix_time::seconds(10));
-    timer.async_wait(
-        [&systemConfiguration](const boost::system::error_code& ec) {
-            if (ec == boost::asio::error::operation_aborted)
+// completes a capture started at the beginning of a scan with the dbus
+// objects the probes used and writes it out
+static void writeScanCapture(nlohmann::json& capture)
+{
+    nlohmann::json& probeObjects = capture["ProbeObjects"];
+    probeObjects = nlohmann::json::object();
+    for (const auto& [interface, objects] : DBUS_PROBE_OBJECTS)
+    {
+        nlohmann::json& captured = probeObjects[interface];
+        captured = nlohmann::json::array();
+        for (const auto& object : objects)
+        {
+            nlohmann::json properties = nlohmann::json::object();
+            for (const auto& [name, value] : object)
             {
-                // we were cancelled
-                return;
+                properties[name] = variantToCapture(value);
             }
+            captured.push_back(std::move(properties));
+        }
+    }
+
+    std::ofstream output(scanCaptureFile);
+    if (!output.good())
+    {
+        std::cerr << "unable to write scan capture " << scanCaptureFile << "\n";
+        return;
+    }
+    output << capture.dump();
+}
 
-            bool powerOff = !isPowerOn();
-            for (const auto& item : lastJson.items())
+int replayScan(const std::string& captureFile)
+{
+    std::ifstream captureStream(captureFile);
+    if (!captureStream.good())
+    {
+        std::cerr << "unable to open " << captureFile << "\n";
+        return EXIT_FAILURE;
+    }
+    nlohmann::json capture =
+        nlohmann::json::parse(captureStream, nullptr, false);
+    if (capture.is_discarded())
+    {
+        std::cerr << "syntax error in " << captureFile << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::list<nlohmann::json> configurations;
+    try
+    {
+        capturedPowerState = capture.at("PowerOn").get<bool>();
+        lastJson = capture.at("LastJson");
+        // only present when a power transition limited the scan
+        auto findPassed = capture.find("PassedProbes");
+        if (findPassed != capture.end())
+        {
+            PASSED_PROBES = findPassed->get<std::vector<std::string>>();
+        }
+        for (const auto& configuration : capture.at("Configurations"))
+        {
+            compileProbeComparisons(configuration);
+            configurations.emplace_back(configuration);
+        }
+        for (const auto& interface : capture.at("ProbeObjects").items())
+        {
+            auto& dbusObjects = DBUS_PROBE_OBJECTS[interface.key()];
+            for (const auto& object : interface.value())
             {
-                if (systemConfiguration.find(item.key()) ==
-                    systemConfiguration.end())
+                auto& properties = dbusObjects.emplace_back();
+                for (const auto& property : object.items())
                 {
-                    bool isDetectedPowerOn = false;
-                    auto powerState = item.value().find("PowerState");
-                    if (powerState != item.value().end())
-                    {
-                        auto ptr = powerState->get_ptr<const std::string*>();
-                        if (ptr)
-                        {
-                            if (*ptr == "On" || *ptr == "BiosPost")
-                            {
-                                isDetectedPowerOn = true;
-                            }
-                        }
-                    }
-                    if (powerOff && isDetectedPowerOn)
-                    {
-                        // power not on yet, don't know if it's there or not
-                        continue;
-                    }
-                    if (!powerOff && scannedPowerOff && isDetectedPowerOn)
-                    {
-                        // already logged it when power was off
-                        continue;
-                    }
-
-                    logDeviceRemoved(item.value());
+                    properties[property.key()] =
+                        variantFromCapture(property.value());
                 }
             }
-            scannedPowerOff = true;
-            if (!powerOff)
-            {
-                scannedPowerOn = true;
-            }
-        });
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "invalid capture " << captureFile << ": " << e.what()
+                  << "\n";
+        return EXIT_FAILURE;
+    }
+
+    // without a bus every probe resolves from the captured objects, so the
+    // scan has completed once the io_service runs out of worker completions
+    nlohmann::json systemConfiguration = nlohmann::json::object();
+    nlohmann::json missingConfigurations = nlohmann::json::object();
+    boost::asio::io_service io;
+    scanWorkers = std::make_unique<ScanWorkers>(io, scanWorkerCount());
+    auto start = std::chrono::steady_clock::now();
+    {
+        auto scan = std::make_shared<PerformScan>(
+            systemConfiguration, missingConfigurations, configurations,
+            []() {});
+        scan->run();
+    }
+    io.run();
+    scanWorkers.reset();
+    auto total = std::chrono::steady_clock::now() - start;
+    scanStatistics.commit();
+
+    std::cout << systemConfiguration.dump(4) << "\n";
+
+    for (size_t ii = 0; ii < scanPhaseCount; ii++)
+    {
+        const PhaseStatistics& phase =
+            scanStatistics.phase(static_cast<ScanPhase>(ii));
+        if (phase.count)
+        {
+            std::cerr << scanPhaseNames[ii] << ": " << phase.last << "us\n";
+        }
+    }
+    std::cerr << "Total: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(total)
+                     .count()
+              << "us\n";
+    std::cerr << "Interned: " << InternedString::count() << " strings, "
+              << internedBytesSaved() << " bytes saved\n";
+    for (const auto& [store, bytes, count] :
+         getMemoryUsage(systemConfiguration, {}))
+    {
+        std::cerr << store << ": " << bytes << " bytes, " << count
+                  << " entries\n";
+    }
+    return EXIT_SUCCESS;
 }
 
 // main properties changed entry
@@ -1724,11 +3418,23 @@ void propertiesChangedCallback(
     boost::asio::io_service& io,
     std::vector<sdbusplus::bus::match::match>& dbusMatches,
     nlohmann::json& systemConfiguration,
-    sdbusplus::asio::object_server& objServer)
+    sdbusplus::asio::object_server& objServer, bool powerGatedOnly)
 {
     static boost::asio::deadline_timer timer(io);
     static bool timerRunning;
+    static bool fullScanPending;
+    static std::chrono::steady_clock::time_point debounceStart;
+
+    // anything other than a power transition needs everything probed
+    if (!powerGatedOnly)
+    {
+        fullScanPending = true;
+    }
 
+    if (!timerRunning)
+    {
+        debounceStart = std::chrono::steady_clock::now();
+    }
     timerRunning = true;
     timer.expires_from_now(boost::posix_time::seconds(1));
 
@@ -1745,19 +3451,93 @@ void propertiesChangedCallback(
             return;
         }
         timerRunning = false;
+        scanStatistics.accumulate(ScanPhase::debounce,
+                                  std::chrono::steady_clock::now() -
+                                      debounceStart);
+        bool partial = !fullScanPending;
+        fullScanPending = false;
 
         nlohmann::json oldConfiguration = systemConfiguration;
-        DBUS_PROBE_OBJECTS.clear();
 
         std::list<nlohmann::json> configurations;
+        auto fileLoadStart = std::chrono::steady_clock::now();
         if (!findJsonFiles(configurations))
         {
             std::cerr << "cannot find json files\n";
+            scanStatistics.discard();
             return;
         }
+        scanStatistics.accumulate(ScanPhase::fileLoad,
+                                  std::chrono::steady_clock::now() -
+                                      fileLoadStart);
+
+        boost::container::flat_set<std::string> powerGated;
+        if (partial)
+        {
+            partitionPowerGated(configurations, powerGated);
+        }
+        else
+        {
+            clearProbeObjects();
+            // every scan probes everything again so removals are seen
+            PASSED_PROBES.clear();
+        }
+
+        nlohmann::json capture;
+        if (!scanCaptureFile.empty())
+        {
+            capture["PowerOn"] = isPowerOn();
+            capture["LastJson"] = lastJson;
+            capture["Configurations"] = configurations;
+            capture["PassedProbes"] = PASSED_PROBES;
+        }
+
+        // everything published or remembered from the last boot has to be
+        // found again, what isn't is queued for removal. A power transition
+        // only rescans what depends on power, so only that can go missing.
+        auto missingConfigurations =
+            std::make_shared<nlohmann::json>(nlohmann::json::object());
+        for (const nlohmann::json* known : {&systemConfiguration, &lastJson})
+        {
+            for (const auto& item : known->items())
+            {
+                if (partial && !isPowerGated(item.value(), powerGated))
+                {
+                    continue;
+                }
+                if (missingConfigurations->find(item.key()) ==
+                    missingConfigurations->end())
+                {
+                    (*missingConfigurations)[item.key()] = item.value();
+                }
+            }
+        }
+        // what the scan finds is erased from missingConfigurations as it goes
+        boost::container::flat_set<std::string> scanned;
+        for (const auto& item : missingConfigurations->items())
+        {
+            scanned.insert(item.key());
+        }
+        bool powerOn = scanPowerState();
 
+        if (!scanWorkers)
+        {
+            scanWorkers = std::make_unique<ScanWorkers>(io, scanWorkerCount());
+        }
+        scansInProgress++;
         auto perfScan = std::make_shared<PerformScan>(
-            systemConfiguration, configurations, [&, oldConfiguration]() {
+            systemConfiguration, *missingConfigurations, configurations,
+            [&, oldConfiguration, missingConfigurations,
+             scanned{std::move(scanned)}, powerOn,
+             capture{std::move(capture)}]() mutable {
+                scansInProgress--;
+                updatePendingRemovals(scanned, *missingConfigurations,
+                                      powerOn);
+
+                if (!scanCaptureFile.empty())
+                {
+                    writeScanCapture(capture);
+                }
                 nlohmann::json newConfiguration = systemConfiguration;
                 for (auto it = newConfiguration.begin();
                      it != newConfiguration.end();)
@@ -1772,10 +3552,31 @@ void propertiesChangedCallback(
                         it++;
                     }
                 }
+
+                nlohmann::json overlayConfiguration = newConfiguration;
+                if (provisionalConfiguration)
+                {
+                    // records from the warm start that are still there stay
+                    // on dbus untouched, but their overlays were never loaded.
+                    // The ones that weren't found go through the removal
+                    // timer like any other record.
+                    overlayConfiguration = systemConfiguration;
+                    for (const auto& item : missingConfigurations->items())
+                    {
+                        overlayConfiguration.erase(item.key());
+                    }
+                    provisionalConfiguration = false;
+                    provisionalIface->set_property("Provisional", false);
+                }
+
                 registerCallbacks(io, dbusMatches, systemConfiguration,
                                   objServer);
-                io.post([&, newConfiguration]() {
-                    loadOverlays(newConfiguration);
+                io.post([&, newConfiguration, overlayConfiguration]() {
+                    auto overlayStart = std::chrono::steady_clock::now();
+                    loadOverlays(overlayConfiguration);
+                    scanStatistics.accumulate(
+                        ScanPhase::overlayLoad,
+                        std::chrono::steady_clock::now() - overlayStart);
 
                     io.post([&]() {
                         if (!writeJsonFiles(systemConfiguration))
@@ -1784,12 +3585,20 @@ void propertiesChangedCallback(
                         }
                     });
                     io.post([&, newConfiguration]() {
+                        auto postStart = std::chrono::steady_clock::now();
                         postToDbus(newConfiguration, systemConfiguration,
                                    objServer);
-                        if (!timerRunning)
-                        {
-                            startRemovedTimer(timer, systemConfiguration);
-                        }
+                        scanStatistics.accumulate(
+                            ScanPhase::postToDbus,
+                            std::chrono::steady_clock::now() - postStart);
+                        scanStatistics.commit();
+                        updateStatisticsInterface();
+                        startRemovalTimer(io, systemConfiguration, objServer);
+
+                        // the scan copies of every configuration file are
+                        // gone by now, hand the pages back instead of letting
+                        // them fragment the heap until the next scan
+                        malloc_trim(0);
                     });
                 });
             });
@@ -1827,95 +3636,3 @@ void registerCallbacks(boost::asio::io_service& io,
         dbusMatches.emplace_back(std::move(match));
     }
 }
-
-int main()
-{
-    // setup connection to dbus
-    boost::asio::io_service io;
-    SYSTEM_BUS = std::make_shared<sdbusplus::asio::connection>(io);
-    SYSTEM_BUS->request_name("xyz.openbmc_project.EntityManager");
-
-    sdbusplus::asio::object_server objServer(SYSTEM_BUS);
-
-    std::shared_ptr<sdbusplus::asio::dbus_interface> entityIface =
-        objServer.add_interface("/xyz/openbmc_project/EntityManager",
-                                "xyz.openbmc_project.EntityManager");
-
-    std::shared_ptr<sdbusplus::asio::dbus_interface> inventoryIface =
-        objServer.add_interface("/xyz/openbmc_project/inventory",
-                                "xyz.openbmc_project.Inventory.Manager");
-
-    // to keep reference to the match / filter objects so they don't get
-    // destroyed
-    std::vector<sdbusplus::bus::match::match> dbusMatches;
-
-    nlohmann::json systemConfiguration = nlohmann::json::object();
-
-    inventoryIface->register_method(
-        "Notify",
-        [](const boost::container::flat_map<
-            std::string,
-            boost::container::flat_map<std::string, BasicVariantType>>&) {
-            return;
-        });
-    inventoryIface->initialize();
-
-    io.post([&]() {
-#if OVERLAYS
-        unloadAllOverlays();
-#endif
-        propertiesChangedCallback(io, dbusMatches, systemConfiguration,
-                                  objServer);
-    });
-
-    entityIface->register_method("ReScan", [&]() {
-        propertiesChangedCallback(io, dbusMatches, systemConfiguration,
-                                  objServer);
-    });
-    entityIface->initialize();
-
-    if (fwVersionIsSame())
-    {
-        if (std::filesystem::is_regular_file(currentConfiguration))
-        {
-            // this file could just be deleted, but it's nice for debug
-            std::filesystem::create_directory(tempConfigDir);
-            std::filesystem::remove(lastConfiguration);
-            std::filesystem::copy(currentConfiguration, lastConfiguration);
-            std::filesystem::remove(currentConfiguration);
-
-            std::ifstream jsonStream(lastConfiguration);
-            if (jsonStream.good())
-            {
-                auto data = nlohmann::json::parse(jsonStream, nullptr, false);
-                if (data.is_discarded())
-                {
-                    std::cerr << "syntax error in " << lastConfiguration
-                              << "\n";
-                }
-                else
-                {
-                    lastJson = std::move(data);
-                }
-            }
-            else
-            {
-                std::cerr << "unable to open " << lastConfiguration << "\n";
-            }
-        }
-    }
-    else
-    {
-        // not an error, just logging at this level to make it in the journal
-        std::cerr << "Clearing previous configuration\n";
-        std::filesystem::remove(currentConfiguration);
-    }
-
-    // some boards only show up after power is on, we want to not say they are
-    // removed until the same state happens
-    setupPowerMatch(SYSTEM_BUS);
-
-    io.run();
-
-    return 0;
-}
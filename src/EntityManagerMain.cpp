@@ -0,0 +1,155 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "EntityManager.hpp"
+
+#include <Overlay.hpp>
+#include <Utils.hpp>
+#include <boost/container/flat_map.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.hpp>
+#include <sdbusplus/asio/connection.hpp>
+#include <sdbusplus/asio/object_server.hpp>
+
+int main(int argc, char** argv)
+{
+    for (int ii = 1; ii < argc; ii++)
+    {
+        std::string arg = argv[ii];
+        if ((arg == "--capture" || arg == "--replay") && ii + 1 < argc)
+        {
+            std::string file = argv[++ii];
+            if (arg == "--replay")
+            {
+                return replayScan(file);
+            }
+            scanCaptureFile = file;
+        }
+        else
+        {
+            std::cerr << "usage: " << argv[0]
+                      << " [--capture <file> | --replay <file>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // setup connection to dbus
+    boost::asio::io_service io;
+    SYSTEM_BUS = std::make_shared<sdbusplus::asio::connection>(io);
+    SYSTEM_BUS->request_name("xyz.openbmc_project.EntityManager");
+
+    sdbusplus::asio::object_server objServer(SYSTEM_BUS);
+
+    std::shared_ptr<sdbusplus::asio::dbus_interface> entityIface =
+        objServer.add_interface("/xyz/openbmc_project/EntityManager",
+                                "xyz.openbmc_project.EntityManager");
+
+    std::shared_ptr<sdbusplus::asio::dbus_interface> inventoryIface =
+        objServer.add_interface("/xyz/openbmc_project/inventory",
+                                "xyz.openbmc_project.Inventory.Manager");
+
+    // to keep reference to the match / filter objects so they don't get
+    // destroyed
+    std::vector<sdbusplus::bus::match::match> dbusMatches;
+
+    nlohmann::json systemConfiguration = nlohmann::json::object();
+
+    inventoryIface->register_method(
+        "Notify",
+        [](const boost::container::flat_map<
+            std::string,
+            boost::container::flat_map<std::string, BasicVariantType>>&) {
+            return;
+        });
+    inventoryIface->initialize();
+
+    createStatisticsInterface(objServer);
+    loadRemovalPolicy();
+
+    io.post([&]() {
+#if OVERLAYS
+        unloadAllOverlays();
+#endif
+        propertiesChangedCallback(io, dbusMatches, systemConfiguration,
+                                  objServer);
+    });
+
+    entityIface->register_method("ReScan", [&]() {
+        propertiesChangedCallback(io, dbusMatches, systemConfiguration,
+                                  objServer);
+    });
+    entityIface->register_method("GetMemoryUsage", [&]() {
+        return getMemoryUsage(systemConfiguration, dbusMatches);
+    });
+#if WARM_START
+    entityIface->register_property("Provisional", false);
+#endif
+    entityIface->initialize();
+
+    if (fwVersionIsSame())
+    {
+        if (std::filesystem::is_regular_file(currentConfiguration))
+        {
+            // this file could just be deleted, but it's nice for debug
+            std::filesystem::create_directory(tempConfigDir);
+            std::filesystem::remove(lastConfiguration);
+            std::filesystem::copy(currentConfiguration, lastConfiguration);
+            std::filesystem::remove(currentConfiguration);
+
+            std::ifstream jsonStream(lastConfiguration);
+            if (jsonStream.good())
+            {
+                auto data = nlohmann::json::parse(jsonStream, nullptr, false);
+                if (data.is_discarded())
+                {
+                    std::cerr << "syntax error in " << lastConfiguration
+                              << "\n";
+                }
+                else
+                {
+                    lastJson = std::move(data);
+#if WARM_START
+                    publishProvisionalConfiguration(systemConfiguration,
+                                                    objServer, entityIface);
+#endif
+                }
+            }
+            else
+            {
+                std::cerr << "unable to open " << lastConfiguration << "\n";
+            }
+        }
+    }
+    else
+    {
+        // not an error, just logging at this level to make it in the journal
+        std::cerr << "Clearing previous configuration\n";
+        std::filesystem::remove(currentConfiguration);
+    }
+
+    // some boards only show up after power is on, we want to not say they are
+    // removed until the same state happens
+    setupPowerMatch(SYSTEM_BUS, [&](bool) {
+        propertiesChangedCallback(io, dbusMatches, systemConfiguration,
+                                  objServer, true);
+    });
+
+    io.run();
+
+    return 0;
+}
@@ -19,18 +19,24 @@
 #include <sys/inotify.h>
 #include <sys/ioctl.h>
 
+#include <FruParser.hpp>
 #include <Utils.hpp>
+#include <atomic>
+#include <bitset>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/container/flat_map.hpp>
 #include <chrono>
+#include <condition_variable>
 #include <ctime>
 #include <fstream>
-#include <future>
 #include <iostream>
+#include <mutex>
 #include <nlohmann/json.hpp>
+#include <optional>
 #include <regex>
 #include <sdbusplus/asio/connection.hpp>
 #include <sdbusplus/asio/object_server.hpp>
+#include <set>
 #include <string>
 #include <thread>
 #include <variant>
@@ -38,6 +44,7 @@
 extern "C" {
 #include <i2c/smbus.h>
 #include <linux/i2c-dev.h>
+#include <linux/i2c.h>
 }
 
 namespace fs = std::filesystem;
@@ -45,9 +52,16 @@ static constexpr bool DEBUG = false;
 static size_t UNKNOWN_BUS_OBJECT_COUNT = 0;
 constexpr size_t MAX_FRU_SIZE = 512;
 constexpr size_t MAX_EEPROM_PAGE_INDEX = 255;
-constexpr size_t busTimeoutSeconds = 5;
+// longest a single device may take to read before its bus is given up on
+constexpr auto deviceTimeout = std::chrono::seconds(2);
+// segments of the i2c tree scanned at the same time
+constexpr size_t maxScanThreads = 4;
 
 constexpr const char* blacklistPath = PACKAGE_DIR "blacklist.json";
+constexpr const char* addressingPath = PACKAGE_DIR "addressing.json";
+constexpr const char* fruCachePath = "/var/cache/fru-device/frus.json";
+constexpr const char* systemConfigurationPath =
+    "/var/configuration/system.json";
 
 const static constexpr char* BASEBOARD_FRU_LOCATION =
     "/etc/fru/baseboard.fru.bin";
@@ -59,10 +73,77 @@ static constexpr std::array<const char*, 5> FRU_AREAS = {
 const static std::regex NON_ASCII_REGEX("[^\x01-\x7f]");
 using DeviceMap = boost::container::flat_map<int, std::vector<char>>;
 using BusMap = boost::container::flat_map<int, std::shared_ptr<DeviceMap>>;
+// addresses where a fru is expected, by bus
+using ScanHints = boost::container::flat_map<size_t, std::set<int>>;
+// buses a scan didn't read in full, with the first address it didn't get to.
+// Addresses are scanned in ascending order, so none from there on was read
+using IncompleteBuses = boost::container::flat_map<size_t, int>;
 
 static std::set<size_t> busBlacklist;
+// buses are scanned from several threads
+static std::mutex busBlacklistMutex;
+
+// a bus that times out is skipped for quarantineBase, doubled with every
+// further timeout up to quarantineMax. A clean scan starts over
+constexpr auto quarantineBase = std::chrono::seconds(30);
+constexpr auto quarantineMax = std::chrono::seconds(3600);
+
+// counted per bus since startup, guarded by busBlacklistMutex
+struct BusHealth
+{
+    uint64_t timeouts = 0;
+    // devices that answered the probe but failed a read
+    uint64_t nacks = 0;
+    // frus read
+    uint64_t reads = 0;
+    // timeouts since the last clean scan
+    uint32_t strikes = 0;
+    // the scan thread is still stuck in the kernel
+    bool hung = false;
+    std::chrono::steady_clock::time_point quarantinedUntil;
+};
+static boost::container::flat_map<size_t, BusHealth> busHealth;
+
+// busBlacklistMutex has to be held
+static bool busQuarantined(size_t bus)
+{
+    auto health = busHealth.find(bus);
+    return health != busHealth.end() &&
+           (health->second.hung ||
+            std::chrono::steady_clock::now() < health->second.quarantinedUntil);
+}
 struct FindDevicesWithCallback;
 
+// addresses picked in blacklist.json, keyed by bus. A key of -1 applies to
+// every bus
+struct AddressFilter
+{
+    // when any are set, only these are scanned
+    std::bitset<128> include;
+    std::bitset<128> exclude;
+};
+static boost::container::flat_map<int, AddressFilter> addressFilters;
+
+static bool addressAllowed(int bus, int address)
+{
+    for (int key : {-1, bus})
+    {
+        auto filter = addressFilters.find(key);
+        if (filter == addressFilters.end())
+        {
+            continue;
+        }
+        const AddressFilter& addresses = filter->second;
+        size_t index = static_cast<size_t>(address);
+        if (addresses.exclude.test(index) ||
+            (addresses.include.any() && !addresses.include.test(index)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 static BusMap busMap;
 
 static bool isMuxBus(size_t bus)
@@ -71,6 +152,35 @@ static bool isMuxBus(size_t bus)
         "/sys/bus/i2c/devices/i2c-" + std::to_string(bus) + "/mux_device"));
 }
 
+// buses that have to be scanned one after another. A mux's channels are only
+// reachable one at a time and go through the adapter the mux hangs off, so a
+// whole mux tree, nested muxes included, is keyed on its root adapter: the one
+// reached by following mux_device up until there is none. Every other bus is a
+// segment of its own
+static std::string busSegment(size_t bus)
+{
+    constexpr size_t maxMuxDepth = 16;
+    std::string adapter = "i2c-" + std::to_string(bus);
+    for (size_t depth = 0; depth < maxMuxDepth; depth++)
+    {
+        std::error_code ec;
+        // the mux device lives in the directory of its parent adapter
+        fs::path muxDevice = fs::canonical(
+            "/sys/bus/i2c/devices/" + adapter + "/mux_device", ec);
+        if (ec)
+        {
+            break;
+        }
+        std::string parent = muxDevice.parent_path().filename().string();
+        if (!boost::starts_with(parent, "i2c-"))
+        {
+            break;
+        }
+        adapter = std::move(parent);
+    }
+    return adapter;
+}
+
 static int isDevice16Bit(int file)
 {
 #ifdef USE_16BIT_ADDR
@@ -138,166 +248,737 @@ static int read_block_data(int flag, int file, uint16_t offset, uint8_t len,
 #endif
 }
 
-bool validateHeader(const std::array<uint8_t, I2C_SMBUS_BLOCK_MAX>& blockData)
+// reads len bytes at offset with one combined write offset, read data
+// transfer, for adapters that report I2C_FUNC_I2C
+static int read_i2c_data(int flag, int file, uint16_t address, uint16_t offset,
+                         uint16_t len, uint8_t* buf)
 {
-    // ipmi spec format version number is currently at 1, verify it
-    if (blockData[0] != 0x1)
+    std::array<uint8_t, 2> offsetBytes = {static_cast<uint8_t>(offset >> 8),
+                                          static_cast<uint8_t>(offset)};
+    std::array<i2c_msg, 2> msgs;
+    msgs[0].addr = address;
+    msgs[0].flags = 0;
+    if (flag == 0)
     {
-        return false;
+        msgs[0].len = 1;
+        msgs[0].buf = &offsetBytes[1];
+    }
+    else
+    {
+        msgs[0].len = 2;
+        msgs[0].buf = offsetBytes.data();
     }
+    msgs[1].addr = address;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len = len;
+    msgs[1].buf = buf;
+
+    i2c_rdwr_ioctl_data data;
+    data.msgs = msgs.data();
+    data.nmsgs = msgs.size();
+    return ioctl(file, I2C_RDWR, &data);
+}
 
-    // verify pad is set to 0
-    if (blockData[6] != 0x0)
+// reads len bytes at offset, in one transfer when the adapter takes plain i2c
+// messages and in smbus block sized chunks otherwise. Adapters that limit the
+// length of a transfer fall back to chunks as well
+static int read_fru_data(int flag, int file, uint16_t address, bool rawI2c,
+                         uint16_t offset, uint16_t len, uint8_t* buf)
+{
+    if (rawI2c && read_i2c_data(flag, file, address, offset, len, buf) >= 0)
     {
-        return false;
+        return 0;
+    }
+    while (len > 0)
+    {
+        uint8_t to_get = static_cast<uint8_t>(std::min<uint16_t>(0x20, len));
+        if (read_block_data(flag, file, offset, to_get, buf) < 0)
+        {
+            return -1;
+        }
+        offset = static_cast<uint16_t>(offset + to_get);
+        buf += to_get;
+        len = static_cast<uint16_t>(len - to_get);
+    }
+    return 0;
+}
+
+bool validateHeader(const std::array<uint8_t, I2C_SMBUS_BLOCK_MAX>& blockData)
+{
+    return validateFruHeader(
+        std::string_view(reinterpret_cast<const char*>(blockData.data()), 8));
+}
+
+// the contents of every fru read before, kept on disk so a boot where the
+// hardware didn't change only reads the header and the tail of each eeprom.
+// Devices that answer without a fru only keep the 8 bytes read as a header
+struct FruCacheEntry
+{
+    std::vector<char> data;
+    // raw offset of the last 8 bytes of data on the eeprom
+    uint16_t tailOffset = 0;
+    // the addressing width isDevice16Bit detected, trusted while the first 8
+    // bytes of data read back the same with it
+    int flag = -1;
+    // read in full since startup, served entries are checked in the
+    // background once the inventory is published
+    bool verified = false;
+};
+
+static boost::container::flat_map<std::pair<int, int>, FruCacheEntry>
+    fruCache;
+// entries served without a full read, waiting for the verifier
+static std::set<std::pair<int, int>> unverifiedFrus;
+static bool fruCacheDirty = false;
+// filled from the scan threads
+static std::mutex fruCacheMutex;
+
+static void loadFruCache(void)
+{
+    std::ifstream cacheStream(fruCachePath);
+    if (!cacheStream.good())
+    {
+        return;
+    }
+    nlohmann::json data = nlohmann::json::parse(cacheStream, nullptr, false);
+    if (!data.is_array())
+    {
+        std::cerr << "Ignoring malformed fru cache " << fruCachePath << "\n";
+        return;
+    }
+    try
+    {
+        for (const auto& entry : data)
+        {
+            FruCacheEntry& cached =
+                fruCache[std::make_pair(entry.at("Bus").get<int>(),
+                                        entry.at("Address").get<int>())];
+            std::vector<uint8_t> bytes =
+                entry.at("Data").get<std::vector<uint8_t>>();
+            cached.data.assign(bytes.begin(), bytes.end());
+            cached.tailOffset = entry.at("TailOffset").get<uint16_t>();
+            auto width = entry.find("AddressWidth");
+            if (width != entry.end())
+            {
+                cached.flag = width->get<int>() == 16 ? 1 : 0;
+            }
+        }
+    }
+    catch (const nlohmann::detail::exception& e)
+    {
+        std::cerr << "Ignoring malformed fru cache " << fruCachePath << ": "
+                  << e.what() << "\n";
+        fruCache.clear();
     }
+}
 
-    // verify offsets are 0, or don't point to another offset
-    std::set<uint8_t> foundOffsets;
-    for (int ii = 1; ii < 6; ii++)
+static void writeFruCache(void)
+{
+    nlohmann::json data = nlohmann::json::array();
     {
-        if (blockData[ii] == 0)
+        std::lock_guard<std::mutex> lock(fruCacheMutex);
+        if (!fruCacheDirty)
         {
-            continue;
+            return;
         }
-        auto inserted = foundOffsets.insert(blockData[ii]);
-        if (!inserted.second)
+        fruCacheDirty = false;
+        for (const auto& [key, cached] : fruCache)
         {
-            return false;
+            nlohmann::json& entry = data.emplace_back(nlohmann::json{
+                {"Bus", key.first},
+                {"Address", key.second},
+                {"TailOffset", cached.tailOffset},
+                {"Data", std::vector<uint8_t>(cached.data.begin(),
+                                              cached.data.end())}});
+            if (cached.flag >= 0)
+            {
+                entry["AddressWidth"] = cached.flag ? 16 : 8;
+            }
         }
     }
 
-    // validate checksum
-    size_t sum = 0;
-    for (int jj = 0; jj < 7; jj++)
+    std::error_code ec;
+    fs::create_directories(fs::path(fruCachePath).parent_path(), ec);
+    // written aside and renamed so a power cut leaves the old cache intact
+    std::string tmpPath = std::string(fruCachePath) + ".tmp";
+    std::ofstream output(tmpPath);
+    if (!output.good())
+    {
+        std::cerr << "unable to write fru cache " << fruCachePath << "\n";
+        return;
+    }
+    output << data;
+    output.close();
+    fs::rename(tmpPath, fruCachePath, ec);
+    if (ec)
+    {
+        std::cerr << "unable to write fru cache " << fruCachePath << ": "
+                  << ec.message() << "\n";
+    }
+}
+
+static void storeInFruCache(int bus, int address, const std::vector<char>& data,
+                            uint16_t tailOffset, int flag)
+{
+    std::lock_guard<std::mutex> lock(fruCacheMutex);
+    FruCacheEntry& cached = fruCache[std::make_pair(bus, address)];
+    if (cached.data != data || cached.tailOffset != tailOffset ||
+        cached.flag != flag)
+    {
+        cached.data = data;
+        cached.tailOffset = tailOffset;
+        cached.flag = flag;
+        fruCacheDirty = true;
+    }
+    cached.verified = true;
+}
+
+// addressing widths set in addressingPath, keyed by bus and address. An
+// address of -1 applies to the whole bus
+static boost::container::flat_map<std::pair<int, int>, int>
+    addressWidthOverrides;
+
+// the addressing width configured for the device, or -1 to detect it
+static int configuredAddressWidth(int bus, int address)
+{
+    auto found = addressWidthOverrides.find(std::make_pair(bus, address));
+    if (found == addressWidthOverrides.end())
+    {
+        found = addressWidthOverrides.find(std::make_pair(bus, -1));
+    }
+    return found == addressWidthOverrides.end() ? -1 : found->second;
+}
+
+// the addressing width detected the last time the device was read, or -1.
+// identity is set to the first 8 bytes read back then
+static int cachedAddressWidth(int bus, int address, std::vector<char>& identity)
+{
+    std::lock_guard<std::mutex> lock(fruCacheMutex);
+    auto cached = fruCache.find(std::make_pair(bus, address));
+    if (cached == fruCache.end() || cached->second.flag < 0 ||
+        cached->second.data.size() < 8)
+    {
+        return -1;
+    }
+    identity.assign(cached->second.data.begin(),
+                    cached->second.data.begin() + 8);
+    return cached->second.flag;
+}
+
+static void eraseFromFruCache(int bus, int address)
+{
+    std::lock_guard<std::mutex> lock(fruCacheMutex);
+    if (fruCache.erase(std::make_pair(bus, address)))
+    {
+        fruCacheDirty = true;
+    }
+}
+
+// device holds the common header read from the eeprom, on a hit it's replaced
+// with the cached contents. The tail is read back as well as a header alone
+// doesn't tell two boards of the same layout apart
+static bool readFromFruCache(int flag, int file, int bus, int address,
+                             bool rawI2c, std::vector<char>& device)
+{
+    std::vector<char> data;
+    uint16_t tailOffset = 0;
     {
-        sum += blockData[jj];
+        std::lock_guard<std::mutex> lock(fruCacheMutex);
+        auto cached = fruCache.find(std::make_pair(bus, address));
+        if (cached == fruCache.end() || cached->second.data.size() < 16 ||
+            !std::equal(device.begin(), device.end(),
+                        cached->second.data.begin()))
+        {
+            return false;
+        }
+        data = cached->second.data;
+        tailOffset = cached->second.tailOffset;
     }
-    sum = (256 - sum) & 0xFF;
 
-    if (sum != blockData[7])
+    std::array<uint8_t, I2C_SMBUS_BLOCK_MAX> block_data;
+    if (read_fru_data(flag, file, static_cast<uint16_t>(address), rawI2c,
+                      tailOffset, 0x8, block_data.data()) < 0 ||
+        !std::equal(data.end() - 8, data.end(), block_data.begin(),
+                    [](char cached, uint8_t read) {
+                        return static_cast<uint8_t>(cached) == read;
+                    }))
     {
         return false;
     }
+
+    device = std::move(data);
+    std::lock_guard<std::mutex> lock(fruCacheMutex);
+    if (!fruCache[std::make_pair(bus, address)].verified)
+    {
+        unverifiedFrus.emplace(bus, address);
+    }
     return true;
 }
 
-int get_bus_frus(int file, int first, int last, int bus,
-                 std::shared_ptr<DeviceMap> devices)
+// reads every area listed in the common header device holds, each to its
+// offset in device so that device mirrors the eeprom. Returns the raw offset
+// of the last 8 bytes read, or -1 if a read failed or proceed, asked before
+// each read, returned false
+static int readFruAreas(int flag, int file, uint16_t address, bool rawI2c,
+                        std::vector<char>& device,
+                        const std::function<bool(void)>& proceed = nullptr)
 {
+    // multi records are chained until one has its end of list bit set
+    constexpr size_t maxMultiRecords = 64;
+    constexpr size_t multiRecordHeaderSize = 5;
 
-    std::future<int> future = std::async(std::launch::async, [&]() {
-        std::array<uint8_t, I2C_SMBUS_BLOCK_MAX> block_data;
+    auto readAt = [&](size_t offset, size_t length) {
+        if (proceed && !proceed())
+        {
+            return false;
+        }
+        if (offset + length > device.size())
+        {
+            device.resize(offset + length);
+        }
+        return read_fru_data(flag, file, address, rawI2c,
+                             static_cast<uint16_t>(offset),
+                             static_cast<uint16_t>(length),
+                             reinterpret_cast<uint8_t*>(&device[offset])) >= 0;
+    };
+
+    // offsets are in multiples of 8 bytes
+    std::array<size_t, FRU_AREAS.size()> offsets;
+    for (size_t jj = 0; jj < offsets.size(); jj++)
+    {
+        offsets[jj] = static_cast<uint8_t>(device[jj + 1]) * size_t(8);
+    }
 
-        for (int ii = first; ii <= last; ii++)
+    for (size_t jj = 0; jj < offsets.size(); jj++)
+    {
+        size_t area_offset = offsets[jj];
+        if (area_offset == 0)
         {
+            continue;
+        }
 
-            // Set slave address
-            if (ioctl(file, I2C_SLAVE_FORCE, ii) < 0)
+        if (std::string(FRU_AREAS[jj]) == "INTERNAL")
+        {
+            // it has no length, only the area after it tells where it ends
+            size_t end = area_offset;
+            for (size_t offset : offsets)
             {
-                std::cerr << "device at bus " << bus << " register " << ii
-                          << "busy\n";
-                continue;
+                if (offset > area_offset &&
+                    (end == area_offset || offset < end))
+                {
+                    end = offset;
+                }
             }
-            // probe
-            else if (i2c_smbus_read_byte(file) < 0)
+            if (end > area_offset && !readAt(area_offset, end - area_offset))
             {
-                continue;
+                return -1;
             }
-
-            if (DEBUG)
+        }
+        else if (std::string(FRU_AREAS[jj]) == "MULTIRECORD")
+        {
+            for (size_t record = 0; record < maxMultiRecords; record++)
+            {
+                if (!readAt(area_offset, multiRecordHeaderSize))
+                {
+                    return -1;
+                }
+                uint8_t sum = 0;
+                for (size_t ii = 0; ii < multiRecordHeaderSize; ii++)
+                {
+                    sum = static_cast<uint8_t>(
+                        sum + static_cast<uint8_t>(device[area_offset + ii]));
+                }
+                if (sum != 0)
+                {
+                    break;
+                }
+                uint8_t flags = static_cast<uint8_t>(device[area_offset + 1]);
+                size_t length = static_cast<uint8_t>(device[area_offset + 2]);
+                if (length > 0 &&
+                    !readAt(area_offset + multiRecordHeaderSize, length))
+                {
+                    return -1;
+                }
+                area_offset += multiRecordHeaderSize + length;
+                // end of list
+                if (flags & 0x80)
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            if (!readAt(area_offset, 8))
             {
-                std::cout << "something at bus " << bus << " addr " << ii
-                          << "\n";
+                return -1;
             }
-
-            /* Check for Device type if it is 8 bit or 16 bit */
-            int flag = isDevice16Bit(file);
-            if (flag < 0)
+            size_t length = static_cast<uint8_t>(device[area_offset + 1]) * 8;
+            if (length > 8 && !readAt(area_offset + 8, length - 8))
             {
-                std::cerr << "failed to read bus " << bus << " address " << ii
-                          << "\n";
-                continue;
+                return -1;
             }
+        }
+    }
+    return static_cast<int>(device.size()) - 8;
+}
+
+// a bus scan shared with the thread running it, so a thread stuck in the
+// kernel can be abandoned and clean up whenever it returns
+struct BusScan
+{
+    // called before each device is read, false once the scan has been
+    // abandoned and the rest of the bus must be left alone
+    bool touch(int address)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        lastProgress = std::chrono::steady_clock::now();
+        current = address;
+        return !abandoned;
+    }
+
+    // false once the scan has been abandoned. Whatever was read after that
+    // can't be trusted, the segment may have switched a mux to another
+    // channel meanwhile
+    bool active(void)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return !abandoned;
+    }
+
+    void found(int address, const std::vector<char>& device)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        devices.emplace(address, device);
+        reads++;
+    }
+
+    void failed(void)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        nacks++;
+    }
 
-            if (read_block_data(flag, file, 0x0, 0x8, block_data.data()) < 0)
+    std::mutex lock;
+    std::condition_variable progress;
+    std::chrono::steady_clock::time_point lastProgress =
+        std::chrono::steady_clock::now();
+    // the address being read
+    int current = 0;
+    DeviceMap devices;
+    uint64_t nacks = 0;
+    uint64_t reads = 0;
+    bool done = false;
+    bool abandoned = false;
+    int result = -1;
+};
+
+static int scanBusFrus(int file, const std::vector<int>& addresses, int bus,
+                       bool rawI2c, BusScan& scan)
+{
+    std::array<uint8_t, I2C_SMBUS_BLOCK_MAX> block_data;
+
+    for (int ii : addresses)
+    {
+        if (!scan.touch(ii))
+        {
+            return -1;
+        }
+        if (!addressAllowed(bus, ii))
+        {
+            continue;
+        }
+
+        // Set slave address
+        if (ioctl(file, I2C_SLAVE_FORCE, ii) < 0)
+        {
+            std::cerr << "device at bus " << bus << " register " << ii
+                      << "busy\n";
+            continue;
+        }
+        // probe
+        else if (i2c_smbus_read_byte(file) < 0)
+        {
+            continue;
+        }
+
+        if (DEBUG)
+        {
+            std::cout << "something at bus " << bus << " addr " << ii
+                      << "\n";
+        }
+
+        uint16_t address = static_cast<uint16_t>(ii);
+        int flag = configuredAddressWidth(bus, ii);
+        bool headerRead = false;
+        if (flag < 0)
+        {
+            // the width detected before holds as long as the same device
+            // answers, which reads back the same first 8 bytes
+            std::vector<char> identity;
+            flag = cachedAddressWidth(bus, ii, identity);
+            headerRead =
+                flag >= 0 &&
+                read_fru_data(flag, file, address, rawI2c, 0x0, 0x8,
+                              block_data.data()) >= 0 &&
+                std::equal(identity.begin(), identity.end(),
+                           block_data.begin(),
+                           [](char cached, uint8_t read) {
+                               return static_cast<uint8_t>(cached) == read;
+                           });
+            if (!headerRead)
             {
-                std::cerr << "failed to read bus " << bus << " address " << ii
-                          << "\n";
-                continue;
+                /* Check for Device type if it is 8 bit or 16 bit */
+                flag = isDevice16Bit(file);
             }
+        }
+        if (flag < 0)
+        {
+            std::cerr << "failed to read bus " << bus << " address " << ii
+                      << "\n";
+            scan.failed();
+            continue;
+        }
+
+        if (!headerRead && read_fru_data(flag, file, address, rawI2c, 0x0,
+                                         0x8, block_data.data()) < 0)
+        {
+            std::cerr << "failed to read bus " << bus << " address " << ii
+                      << "\n";
+            scan.failed();
+            continue;
+        }
+        if (!scan.active())
+        {
+            return -1;
+        }
 
-            // check the header checksum
-            if (!validateHeader(block_data))
+        // check the header checksum
+        if (!validateHeader(block_data))
+        {
+            storeInFruCache(
+                bus, ii,
+                std::vector<char>(block_data.begin(),
+                                  block_data.begin() + 8),
+                0, flag);
+            if (DEBUG)
             {
-                if (DEBUG)
-                {
-                    std::cerr << "Illegal header at bus " << bus << " address "
-                              << ii << "\n";
-                }
-                continue;
+                std::cerr << "Illegal header at bus " << bus << " address "
+                          << ii << "\n";
             }
+            continue;
+        }
 
-            std::vector<char> device;
-            device.insert(device.end(), block_data.begin(),
-                          block_data.begin() + 8);
+        std::vector<char> device;
+        device.insert(device.end(), block_data.begin(),
+                      block_data.begin() + 8);
 
-            for (size_t jj = 1; jj <= FRU_AREAS.size(); jj++)
+        if (readFromFruCache(flag, file, bus, ii, rawI2c, device))
+        {
+            if (!scan.active())
             {
-                auto area_offset = device[jj];
-                if (area_offset == 0)
-                {
-                    continue;
-                }
+                return -1;
+            }
+            scan.found(ii, device);
+            continue;
+        }
 
-                area_offset = static_cast<char>(area_offset * 8);
-                if (read_block_data(flag, file, area_offset, 0x8,
-                                    block_data.data()) < 0)
-                {
-                    std::cerr << "failed to read bus " << bus << " address "
-                              << ii << "\n";
-                    return -1;
-                }
-                int length = block_data[1] * 8;
-                device.insert(device.end(), block_data.begin(),
-                              block_data.begin() + 8);
-                length -= 8;
-                area_offset = static_cast<char>(area_offset + 8);
+        int tailOffset =
+            readFruAreas(flag, file, address, rawI2c, device,
+                         [&scan]() { return scan.active(); });
+        if (!scan.active())
+        {
+            return -1;
+        }
+        if (tailOffset < 0)
+        {
+            std::cerr << "failed to read bus " << bus << " address " << ii
+                      << "\n";
+            scan.failed();
+            return -1;
+        }
+        storeInFruCache(bus, ii, device,
+                        static_cast<uint16_t>(tailOffset), flag);
+        scan.found(ii, device);
+    }
+    return 1;
+}
 
-                while (length > 0)
-                {
-                    auto to_get = std::min(0x20, length);
+// folds a finished or abandoned scan into the health of its bus, the scan
+// lock has to be held
+static void recordBusScan(size_t bus, const BusScan& scan, bool timedOut)
+{
+    std::lock_guard<std::mutex> lock(busBlacklistMutex);
+    BusHealth& health = busHealth[bus];
+    health.nacks += scan.nacks;
+    health.reads += scan.reads;
+    if (!timedOut)
+    {
+        health.strikes = 0;
+        return;
+    }
+    health.timeouts++;
+    health.hung = true;
+    auto quarantine = quarantineBase * (1U << std::min(health.strikes, 16U));
+    health.quarantinedUntil =
+        std::chrono::steady_clock::now() +
+        std::min<std::chrono::steady_clock::duration>(quarantine,
+                                                      quarantineMax);
+    health.strikes++;
+}
 
-                    if (read_block_data(flag, file, area_offset,
-                                        static_cast<uint8_t>(to_get),
-                                        block_data.data()) < 0)
-                    {
-                        std::cerr << "failed to read bus " << bus << " address "
-                                  << ii << "\n";
-                        return -1;
-                    }
-                    device.insert(device.end(), block_data.begin(),
-                                  block_data.begin() + to_get);
-                    area_offset = static_cast<char>(area_offset + to_get);
-                    length -= to_get;
-                }
-            }
-            devices->emplace(ii, device);
+// the scan runs on a thread of its own, as a hung adapter blocks in the
+// kernel for as long as it likes. If a device takes longer than
+// deviceTimeout the thread is left behind and the bus quarantined, the
+// devices found up to then are kept, busScanTimedOut is returned and
+// unreached is set to the address that hung. The thread stops at the next
+// device once the kernel lets it go
+constexpr int busScanTimedOut = -2;
+
+int get_bus_frus(int file, const std::vector<int>& addresses, int bus,
+                 bool rawI2c, std::shared_ptr<DeviceMap> devices,
+                 int& unreached)
+{
+    auto scan = std::make_shared<BusScan>();
+    std::thread([scan, file, addresses, bus, rawI2c]() {
+        int result = scanBusFrus(file, addresses, bus, rawI2c, *scan);
+        close(file);
+
+        std::lock_guard<std::mutex> guard(scan->lock);
+        scan->done = true;
+        scan->result = result;
+        if (scan->abandoned)
+        {
+            std::cerr << "bus " << bus << " recovered\n";
+            std::lock_guard<std::mutex> lock(busBlacklistMutex);
+            busHealth[bus].hung = false;
         }
-        return 1;
-    });
-    std::future_status status =
-        future.wait_for(std::chrono::seconds(busTimeoutSeconds));
-    if (status == std::future_status::timeout)
+        scan->progress.notify_all();
+    })
+        .detach();
+
+    std::unique_lock<std::mutex> lock(scan->lock);
+    while (!scan->done)
+    {
+        auto deadline = scan->lastProgress + deviceTimeout;
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            std::cerr << "Error reading bus " << bus << ", quarantining it\n";
+            scan->abandoned = true;
+            recordBusScan(bus, *scan, true);
+            *devices = scan->devices;
+            unreached = scan->current;
+            return busScanTimedOut;
+        }
+        scan->progress.wait_until(lock, deadline);
+    }
+    recordBusScan(bus, *scan, false);
+    *devices = std::move(scan->devices);
+    return scan->result;
+}
+
+// reads the fru at bus and address in full, device is left empty when
+// something other than a fru answers. Returns the raw offset of the last 8
+// bytes read, or -1 if the device couldn't be read. flag is set to the
+// addressing width used
+static int readFruFromBus(int bus, int address, std::vector<char>& device,
+                          int& flag)
+{
+    std::string i2cBus = "/dev/i2c-" + std::to_string(bus);
+    int file = open(i2cBus.c_str(), O_RDWR | O_CLOEXEC);
+    if (file < 0)
+    {
+        return -1;
+    }
+    unsigned long funcs = 0;
+    bool rawI2c = ioctl(file, I2C_FUNCS, &funcs) >= 0 && (funcs & I2C_FUNC_I2C);
+    uint16_t deviceAddress = static_cast<uint16_t>(address);
+    std::array<uint8_t, I2C_SMBUS_BLOCK_MAX> block_data;
+    flag = configuredAddressWidth(bus, address);
+    if (ioctl(file, I2C_SLAVE_FORCE, address) < 0 ||
+        (flag < 0 && (flag = isDevice16Bit(file)) < 0) ||
+        read_fru_data(flag, file, deviceAddress, rawI2c, 0x0, 0x8,
+                      block_data.data()) < 0)
     {
-        std::cerr << "Error reading bus " << bus << "\n";
-        busBlacklist.insert(bus);
         close(file);
         return -1;
     }
-
+    int tailOffset = 0;
+    if (validateHeader(block_data))
+    {
+        device.insert(device.end(), block_data.begin(),
+                      block_data.begin() + 8);
+        tailOffset = readFruAreas(flag, file, deviceAddress, rawI2c, device);
+    }
     close(file);
-    return future.get();
+    return tailOffset;
+}
+
+// reads the frus that were served from the cache in full, in the background
+// so it doesn't hold up the inventory. Calls done on the io thread with the
+// buses where the eeprom no longer matches its cache entry
+static void
+    verifyFruCache(boost::asio::io_service& io,
+                   std::function<void(const std::set<size_t>&)>&& done)
+{
+    std::set<std::pair<int, int>> frus;
+    {
+        std::lock_guard<std::mutex> lock(fruCacheMutex);
+        frus.swap(unverifiedFrus);
+    }
+    if (frus.empty())
+    {
+        done(std::set<size_t>());
+        return;
+    }
+
+    std::thread([&io, frus, done{std::move(done)}]() {
+        std::set<size_t> changedBuses;
+        for (const auto& [bus, address] : frus)
+        {
+            {
+                std::lock_guard<std::mutex> lock(busBlacklistMutex);
+                if (busBlacklist.find(bus) != busBlacklist.end() ||
+                    busQuarantined(bus))
+                {
+                    continue;
+                }
+            }
+            std::vector<char> device;
+            int flag = -1;
+            int tailOffset = readFruFromBus(bus, address, device, flag);
+            if (tailOffset < 0)
+            {
+                // checked again the next time it's served
+                continue;
+            }
+
+            bool same = false;
+            {
+                std::lock_guard<std::mutex> lock(fruCacheMutex);
+                auto cached = fruCache.find(std::make_pair(bus, address));
+                same = cached != fruCache.end() &&
+                       cached->second.data == device;
+            }
+            if (device.empty())
+            {
+                eraseFromFruCache(bus, address);
+            }
+            else
+            {
+                storeInFruCache(bus, address, device,
+                                static_cast<uint16_t>(tailOffset), flag);
+            }
+            if (!same)
+            {
+                std::cerr << "fru at bus " << bus << " address " << address
+                          << " doesn't match the cache, rescanning\n";
+                changedBuses.insert(static_cast<size_t>(bus));
+            }
+        }
+        io.post([done, changedBuses]() { done(changedBuses); });
+    })
+        .detach();
 }
 
 void loadBlacklist(const char* path)
@@ -321,8 +1002,8 @@ void loadBlacklist(const char* path)
     }
 
     // It's expected to have at least one field, "buses" that is an array of the
-    // buses by integer. Allow for future options to exclude further aspects,
-    // such as specific addresses or ranges.
+    // buses by integer. "include" and "exclude" narrow down the addresses
+    // scanned, per bus or on every bus.
     if (data.type() != nlohmann::json::value_t::object)
     {
         std::cerr << "Illegal blacklist, expected to read dictionary\n";
@@ -360,11 +1041,139 @@ void loadBlacklist(const char* path)
         }
     }
 
+    // Each entry looks like
+    // {"bus": 5, "addresses": [64, 65], "ranges": [[80, 87]]}, without a bus
+    // it applies to every bus.
+    for (const char* field : {"include", "exclude"})
+    {
+        if (data.count(field) == 0)
+        {
+            continue;
+        }
+        try
+        {
+            for (const auto& entry : data.at(field))
+            {
+                int bus = -1;
+                if (entry.count("bus") == 1)
+                {
+                    bus = entry.at("bus").get<int>();
+                }
+                AddressFilter& filter = addressFilters[bus];
+                std::bitset<128>& addresses =
+                    std::string(field) == "include" ? filter.include
+                                                    : filter.exclude;
+
+                std::vector<std::pair<size_t, size_t>> ranges;
+                if (entry.count("addresses") == 1)
+                {
+                    for (const auto& address : entry.at("addresses"))
+                    {
+                        ranges.emplace_back(address.get<size_t>(),
+                                            address.get<size_t>());
+                    }
+                }
+                if (entry.count("ranges") == 1)
+                {
+                    for (const auto& range : entry.at("ranges"))
+                    {
+                        ranges.emplace_back(range.at(0).get<size_t>(),
+                                            range.at(1).get<size_t>());
+                    }
+                }
+                for (const auto& [low, high] : ranges)
+                {
+                    if (low > high || high >= addresses.size())
+                    {
+                        std::cerr << "Invalid address range " << low << " to "
+                                  << high << " in blacklist " << field
+                                  << "\n";
+                        std::exit(EXIT_FAILURE);
+                        return;
+                    }
+                    for (size_t address = low; address <= high; address++)
+                    {
+                        addresses.set(address);
+                    }
+                }
+            }
+        }
+        catch (const nlohmann::detail::exception& e)
+        {
+            // Type mis-match is a critical error.
+            std::cerr << "Invalid blacklist " << field << " entry: "
+                      << e.what() << "\n";
+            std::exit(EXIT_FAILURE);
+            return;
+        }
+    }
+
     return;
 }
 
+// The file looks like
+// {"devices": [{"bus": 5, "width": 16}, {"bus": 6, "address": 80, "width": 8}]}
+void loadAddressWidthOverrides(const char* path)
+{
+    std::ifstream addressingStream(path);
+    if (!addressingStream.good())
+    {
+        // File is optional.
+        return;
+    }
+
+    nlohmann::json data =
+        nlohmann::json::parse(addressingStream, nullptr, false);
+    if (data.is_discarded() ||
+        data.type() != nlohmann::json::value_t::object)
+    {
+        std::cerr << "Illegal addressing file detected, cannot validate "
+                     "JSON, exiting\n";
+        std::exit(EXIT_FAILURE);
+        return;
+    }
+    if (data.count("devices") == 0)
+    {
+        return;
+    }
+
+    // Catch exception here for type mis-match.
+    try
+    {
+        for (const auto& device : data.at("devices"))
+        {
+            int width = device.at("width").get<int>();
+            if (width != 8 && width != 16)
+            {
+                std::cerr << "Invalid addressing width " << width << "\n";
+                std::exit(EXIT_FAILURE);
+                return;
+            }
+            int address = -1;
+            if (device.count("address") == 1)
+            {
+                address = device.at("address").get<int>();
+            }
+            addressWidthOverrides[std::make_pair(
+                device.at("bus").get<int>(), address)] = width == 16 ? 1 : 0;
+        }
+    }
+    catch (const nlohmann::detail::exception& e)
+    {
+        // Type mis-match is a critical error.
+        std::cerr << "Invalid addressing entry: " << e.what() << "\n";
+        std::exit(EXIT_FAILURE);
+        return;
+    }
+}
+
+// scans every address of the buses, or only the hinted ones when hints is
+// set. Buses that were skipped for their quarantine or whose scan timed out
+// are added to incomplete, busmap holds nothing or only part of what is there
+// for them
 static void FindI2CDevices(const std::vector<fs::path>& i2cBuses,
-                           BusMap& busmap)
+                           BusMap& busmap, IncompleteBuses& incomplete,
+                           const ScanHints* hints)
 {
     for (auto& i2cBus : i2cBuses)
     {
@@ -376,9 +1185,39 @@ static void FindI2CDevices(const std::vector<fs::path>& i2cBuses,
             busnum.erase(0, lastDash + 1);
         }
         auto bus = std::stoi(busnum);
-        if (busBlacklist.find(bus) != busBlacklist.end())
         {
-            continue; // skip previously failed busses
+            std::lock_guard<std::mutex> lock(busBlacklistMutex);
+            if (busBlacklist.find(bus) != busBlacklist.end())
+            {
+                continue; // skip previously failed busses
+            }
+            if (busQuarantined(bus))
+            {
+                // tried again once the quarantine runs out
+                incomplete[static_cast<size_t>(bus)] = 0;
+                continue;
+            }
+        }
+
+        std::vector<int> addresses;
+        if (hints)
+        {
+            auto hinted = hints->find(static_cast<size_t>(bus));
+            if (hinted == hints->end())
+            {
+                continue;
+            }
+            addresses.assign(hinted->second.begin(), hinted->second.end());
+        }
+        else
+        {
+            //  i2cdetect by default uses the range 0x03 to 0x77, as
+            //  this is  what we have tested with, use this range. Could be
+            //  changed in future.
+            for (int address = 0x03; address <= 0x77; address++)
+            {
+                addresses.push_back(address);
+            }
         }
 
         auto file = open(i2cBus.c_str(), O_RDWR);
@@ -407,16 +1246,18 @@ static void FindI2CDevices(const std::vector<fs::path>& i2cBuses,
         auto& device = busmap[bus];
         device = std::make_shared<DeviceMap>();
 
-        //  i2cdetect by default uses the range 0x03 to 0x77, as
-        //  this is  what we have tested with, use this range. Could be
-        //  changed in future.
         if (DEBUG)
         {
             std::cerr << "Scanning bus " << bus << "\n";
         }
 
         // fd is closed in this function in case the bus locks up
-        get_bus_frus(file, 0x03, 0x77, bus, device);
+        int unreached = 0;
+        if (get_bus_frus(file, addresses, bus, (funcs & I2C_FUNC_I2C) != 0,
+                         device, unreached) == busScanTimedOut)
+        {
+            incomplete[static_cast<size_t>(bus)] = unreached;
+        }
 
         if (DEBUG)
         {
@@ -425,180 +1266,179 @@ static void FindI2CDevices(const std::vector<fs::path>& i2cBuses,
     }
 }
 
-// this class allows an async response after all i2c devices are discovered
+// this class allows an async response after all i2c devices are discovered.
+// Segments of the i2c tree are scanned on up to maxScanThreads threads, each
+// result is merged on the io thread and busmap and incomplete are replaced
+// once all are done, see FindI2CDevices
 struct FindDevicesWithCallback
     : std::enable_shared_from_this<FindDevicesWithCallback>
 {
     FindDevicesWithCallback(const std::vector<fs::path>& i2cBuses,
                             boost::asio::io_service& io, BusMap& busmap,
-                            std::function<void(void)>&& callback) :
+                            IncompleteBuses& incomplete,
+                            std::function<void(void)>&& callback,
+                            std::shared_ptr<const ScanHints> hints = nullptr) :
         _i2cBuses(i2cBuses),
-        _io(io), _busMap(busmap), _callback(std::move(callback))
-    {
-    }
-    ~FindDevicesWithCallback()
-    {
-        _callback();
-    }
-    void run()
-    {
-        FindI2CDevices(_i2cBuses, _busMap);
-    }
-
-    const std::vector<fs::path>& _i2cBuses;
-    boost::asio::io_service& _io;
-    BusMap& _busMap;
-    std::function<void(void)> _callback;
-};
-
-static const std::tm intelEpoch(void)
-{
-    std::tm val = {};
-    val.tm_year = 1996 - 1900;
-    return val;
-}
-
-bool formatFru(const std::vector<char>& fruBytes,
-               boost::container::flat_map<std::string, std::string>& result)
-{
-    static const std::vector<const char*> CHASSIS_FRU_AREAS = {
-        "PART_NUMBER", "SERIAL_NUMBER", "INFO_AM1", "INFO_AM2"};
-
-    static const std::vector<const char*> BOARD_FRU_AREAS = {
-        "MANUFACTURER",   "PRODUCT_NAME", "SERIAL_NUMBER", "PART_NUMBER",
-        "FRU_VERSION_ID", "INFO_AM1",     "INFO_AM2"};
-
-    static const std::vector<const char*> PRODUCT_FRU_AREAS = {
-        "MANUFACTURER",   "PRODUCT_NAME",  "PART_NUMBER",
-        "VERSION",        "SERIAL_NUMBER", "ASSET_TAG",
-        "FRU_VERSION_ID", "INFO_AM1",      "INFO_AM2"};
-
-    if (fruBytes.size() <= 8)
-    {
-        return false;
-    }
-    std::vector<char>::const_iterator fruAreaOffsetField = fruBytes.begin();
-    result["Common_Format_Version"] =
-        std::to_string(static_cast<int>(*fruAreaOffsetField));
-
-    const std::vector<const char*>* fieldData;
-
-    for (const std::string& area : FRU_AREAS)
-    {
-        fruAreaOffsetField++;
-        if (fruAreaOffsetField >= fruBytes.end())
-        {
-            return false;
-        }
-        size_t offset = (*fruAreaOffsetField) * 8;
-
-        if (offset > 1)
-        {
-            // +2 to skip format and length
-            std::vector<char>::const_iterator fruBytesIter =
-                fruBytes.begin() + offset + 2;
-
-            if (fruBytesIter >= fruBytes.end())
-            {
-                return false;
-            }
-
-            if (area == "CHASSIS")
-            {
-                result["CHASSIS_TYPE"] =
-                    std::to_string(static_cast<int>(*fruBytesIter));
-                fruBytesIter += 1;
-                fieldData = &CHASSIS_FRU_AREAS;
-            }
-            else if (area == "BOARD")
-            {
-                result["BOARD_LANGUAGE_CODE"] =
-                    std::to_string(static_cast<int>(*fruBytesIter));
-                fruBytesIter += 1;
-                if (fruBytesIter >= fruBytes.end())
-                {
-                    return false;
-                }
-
-                unsigned int minutes = *fruBytesIter |
-                                       *(fruBytesIter + 1) << 8 |
-                                       *(fruBytesIter + 2) << 16;
-                std::tm fruTime = intelEpoch();
-                time_t timeValue = mktime(&fruTime);
-                timeValue += minutes * 60;
-                fruTime = *gmtime(&timeValue);
-
-                result["BOARD_MANUFACTURE_DATE"] = asctime(&fruTime);
-                result["BOARD_MANUFACTURE_DATE"]
-                    .pop_back(); // remove trailing null
-                fruBytesIter += 3;
-                fieldData = &BOARD_FRU_AREAS;
-            }
-            else if (area == "PRODUCT")
-            {
-                result["PRODUCT_LANGUAGE_CODE"] =
-                    std::to_string(static_cast<int>(*fruBytesIter));
-                fruBytesIter += 1;
-                fieldData = &PRODUCT_FRU_AREAS;
-            }
-            else
-            {
-                continue;
-            }
-            for (auto& field : *fieldData)
-            {
-                if (fruBytesIter >= fruBytes.end())
-                {
-                    return false;
-                }
-
-                /* Checking for last byte C1 to indicate that no more
-                 * field to be read */
-                if (static_cast<uint8_t>(*fruBytesIter) == 0xC1)
-                {
-                    break;
-                }
-
-                size_t length = *fruBytesIter & 0x3f;
-                fruBytesIter += 1;
-
-                if (fruBytesIter >= fruBytes.end())
-                {
-                    return false;
-                }
-                std::string value(fruBytesIter, fruBytesIter + length);
-
-                // Strip non null characters from the end
-                value.erase(std::find_if(value.rbegin(), value.rend(),
-                                         [](char ch) { return ch != 0; })
-                                .base(),
-                            value.end());
-
-                result[area + "_" + field] = std::move(value);
+        _io(io), _busMap(busmap), _incomplete(incomplete),
+        _callback(std::move(callback)), _hints(std::move(hints))
+    {
+    }
+    ~FindDevicesWithCallback()
+    {
+        _busMap = std::move(_found);
+        _incomplete = std::move(_foundIncomplete);
+        _callback();
+    }
+    void run()
+    {
+        boost::container::flat_map<std::string, std::vector<fs::path>>
+            segments;
+        for (const auto& i2cBus : _i2cBuses)
+        {
+            auto busnum = i2cBus.string();
+            auto lastDash = busnum.rfind(std::string("-"));
+            if (lastDash != std::string::npos)
+            {
+                busnum.erase(0, lastDash + 1);
+            }
+            segments[busSegment(std::stoul(busnum))].push_back(i2cBus);
+        }
+        for (auto& segment : segments)
+        {
+            _segments.emplace_back(std::move(segment.second));
+        }
 
-                fruBytesIter += length;
-                if (fruBytesIter >= fruBytes.end())
+        size_t threads = std::min(maxScanThreads, _segments.size());
+        for (size_t ii = 0; ii < threads; ii++)
+        {
+            // the last reference has to be dropped on the io thread, so it is
+            // handed back with the result
+            std::thread([self = shared_from_this()]() mutable {
+                while (true)
                 {
-                    std::cerr << "Warning Fru Length Mismatch:\n    ";
-                    for (auto& c : fruBytes)
+                    size_t next = self->_nextSegment++;
+                    if (next >= self->_segments.size())
                     {
-                        std::cerr << c;
+                        break;
                     }
-                    std::cerr << "\n";
-                    if (DEBUG)
-                    {
-                        for (auto& keyPair : result)
+                    auto found = std::make_shared<BusMap>();
+                    auto incomplete = std::make_shared<IncompleteBuses>();
+                    FindI2CDevices(self->_segments[next], *found, *incomplete,
+                                   self->_hints.get());
+                    self->_io.post([self, found, incomplete]() {
+                        for (auto& busDevices : *found)
                         {
-                            std::cerr << keyPair.first << " : "
-                                      << keyPair.second << "\n";
+                            self->_found[busDevices.first] =
+                                std::move(busDevices.second);
                         }
-                    }
-                    return false;
+                        self->_foundIncomplete.insert(incomplete->begin(),
+                                                      incomplete->end());
+                    });
                 }
-            }
+                auto& io = self->_io;
+                io.post([self{std::move(self)}]() {});
+            }).detach();
         }
     }
 
+    std::vector<fs::path> _i2cBuses;
+    boost::asio::io_service& _io;
+    BusMap& _busMap;
+    IncompleteBuses& _incomplete;
+    std::function<void(void)> _callback;
+    std::shared_ptr<const ScanHints> _hints;
+    std::vector<std::vector<fs::path>> _segments;
+    std::atomic<size_t> _nextSegment = 0;
+    // only touched on the io thread
+    BusMap _found;
+    IncompleteBuses _foundIncomplete;
+};
+
+static const std::tm intelEpoch(void)
+{
+    std::tm val = {};
+    val.tm_year = 1996 - 1900;
+    return val;
+}
+
+// the names the fields of each area are published under, custom fields
+// follow as INFO_AM1, INFO_AM2 and so on
+static const std::array<const char*, chassisFieldCount> CHASSIS_FRU_FIELDS = {
+    "PART_NUMBER", "SERIAL_NUMBER"};
+
+static const std::array<const char*, boardFieldCount> BOARD_FRU_FIELDS = {
+    "MANUFACTURER", "PRODUCT_NAME", "SERIAL_NUMBER", "PART_NUMBER",
+    "FRU_VERSION_ID"};
+
+static const std::array<const char*, productFieldCount> PRODUCT_FRU_FIELDS = {
+    "MANUFACTURER",  "PRODUCT_NAME", "PART_NUMBER",   "VERSION",
+    "SERIAL_NUMBER", "ASSET_TAG",    "FRU_VERSION_ID"};
+
+template <size_t N>
+static void formatFruFields(
+    const std::string& area, const FruInfoArea& info, uint8_t language,
+    const std::array<const char*, N>& names,
+    boost::container::flat_map<std::string, std::string>& result)
+{
+    for (size_t ii = 0; ii < info.fields.size(); ii++)
+    {
+        std::string name = ii < names.size()
+                               ? names[ii]
+                               : "INFO_AM" + std::to_string(ii - N + 1);
+        result[area + "_" + name] = info.fields[ii].decode(language);
+    }
+}
+
+bool formatFru(const std::vector<char>& fruBytes,
+               boost::container::flat_map<std::string, std::string>& result)
+{
+    if (fruBytes.size() <= 8)
+    {
+        return false;
+    }
+    std::optional<FruData> fru =
+        parseFru(std::string_view(fruBytes.data(), fruBytes.size()));
+    if (!fru)
+    {
+        std::cerr << "Warning Fru Length Mismatch\n";
+        return false;
+    }
+    if (!fru->checksumsValid() && DEBUG)
+    {
+        std::cerr << "Fru checksum mismatch\n";
+    }
+    result["Common_Format_Version"] = std::to_string(fru->formatVersion);
+
+    if (fru->chassis)
+    {
+        result["CHASSIS_TYPE"] = std::to_string(fru->chassis->typeOrLanguage);
+        formatFruFields("CHASSIS", *fru->chassis, 0, CHASSIS_FRU_FIELDS,
+                        result);
+    }
+    if (fru->board)
+    {
+        uint8_t language = fru->board->typeOrLanguage;
+        result["BOARD_LANGUAGE_CODE"] = std::to_string(language);
+
+        std::tm fruTime = intelEpoch();
+        time_t timeValue = mktime(&fruTime);
+        timeValue += fru->board->manufactureMinutes * 60;
+        fruTime = *gmtime(&timeValue);
+        std::string date = asctime(&fruTime);
+        date.pop_back(); // remove trailing newline
+        result["BOARD_MANUFACTURE_DATE"] = std::move(date);
+
+        formatFruFields("BOARD", *fru->board, language, BOARD_FRU_FIELDS,
+                        result);
+    }
+    if (fru->product)
+    {
+        uint8_t language = fru->product->typeOrLanguage;
+        result["PRODUCT_LANGUAGE_CODE"] = std::to_string(language);
+        formatFruFields("PRODUCT", *fru->product, language,
+                        PRODUCT_FRU_FIELDS, result);
+    }
+
     return true;
 }
 
@@ -744,14 +1584,16 @@ static bool readBaseboardFru(std::vector<char>& baseboardFru)
 
 bool writeFru(uint8_t bus, uint8_t address, const std::vector<uint8_t>& fru)
 {
-    boost::container::flat_map<std::string, std::string> tmp;
     if (fru.size() > MAX_FRU_SIZE)
     {
         std::cerr << "Invalid fru.size() during writeFru\n";
         return false;
     }
     // verify legal fru by running it through fru parsing logic
-    if (!formatFru(reinterpret_cast<const std::vector<char>&>(fru), tmp))
+    std::string_view fruView(reinterpret_cast<const char*>(fru.data()),
+                             fru.size());
+    std::optional<FruData> parsed = parseFru(fruView);
+    if (!parsed || !validateFruHeader(fruView) || !parsed->checksumsValid())
     {
         std::cerr << "Invalid fru format during writeFru\n";
         return false;
@@ -833,18 +1675,265 @@ bool writeFru(uint8_t bus, uint8_t address, const std::vector<uint8_t>& fru)
     }
 }
 
+// scans the given buses, or all of them when buses is nullopt, and updates
+// the interfaces of the devices whose contents changed
 void rescanBusses(
+    boost::asio::io_service& io, BusMap& busmap,
+    boost::container::flat_map<
+        std::pair<size_t, size_t>,
+        std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
+    sdbusplus::asio::object_server& objServer,
+    const std::optional<std::set<size_t>>& buses = std::nullopt,
+    bool powerChange = false);
+
+// buses whose contents changed on a power transition, nullopt until the
+// first transition was scanned in full
+static std::optional<std::set<size_t>> powerGatedBuses;
+
+// scans the quarantined ones among buses again once their quarantine runs
+// out. A bus whose scan thread is still hung by then is tried again after
+// another quarantineBase
+static void retryQuarantinedBuses(
+    boost::asio::io_service& io, BusMap& busmap,
+    boost::container::flat_map<
+        std::pair<size_t, size_t>,
+        std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
+    sdbusplus::asio::object_server& objServer, const std::set<size_t>& buses)
+{
+    static boost::asio::deadline_timer retryTimer(io);
+    static bool retryArmed = false;
+    static std::set<size_t> retryBuses;
+
+    auto now = std::chrono::steady_clock::now();
+    std::optional<std::chrono::steady_clock::duration> wait;
+    {
+        std::lock_guard<std::mutex> lock(busBlacklistMutex);
+        for (size_t bus : buses)
+        {
+            if (!busQuarantined(bus))
+            {
+                continue;
+            }
+            const BusHealth& health = busHealth[bus];
+            auto until = health.quarantinedUntil;
+            if (health.hung)
+            {
+                until = std::max(until, now + quarantineBase);
+            }
+            retryBuses.insert(bus);
+            wait = wait ? std::min(*wait, until - now) : until - now;
+        }
+    }
+    if (!wait)
+    {
+        return;
+    }
+
+    auto waitMs = boost::posix_time::milliseconds(
+        std::chrono::duration_cast<std::chrono::milliseconds>(*wait).count());
+    if (retryArmed && retryTimer.expires_from_now() <= waitMs)
+    {
+        return;
+    }
+    retryArmed = true;
+    retryTimer.expires_from_now(waitMs);
+    retryTimer.async_wait([&](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+        {
+            // brought forward for a shorter quarantine
+            return;
+        }
+        retryArmed = false;
+        std::set<size_t> retry;
+        retry.swap(retryBuses);
+        rescanBusses(io, busmap, dbusInterfaceMap, objServer, retry);
+    });
+}
+
+// timeouts, nacks, reads, consecutive timeouts and seconds of quarantine left
+// for every bus that was scanned
+static std::vector<
+    std::tuple<uint32_t, uint64_t, uint64_t, uint64_t, uint32_t, uint64_t>>
+    getBusHealth(void)
+{
+    std::vector<
+        std::tuple<uint32_t, uint64_t, uint64_t, uint64_t, uint32_t, uint64_t>>
+        ret;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(busBlacklistMutex);
+    for (const auto& [bus, health] : busHealth)
+    {
+        uint64_t quarantineLeft = 0;
+        if (health.quarantinedUntil > now)
+        {
+            quarantineLeft = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::seconds>(
+                    health.quarantinedUntil - now)
+                    .count());
+        }
+        ret.emplace_back(static_cast<uint32_t>(bus), health.timeouts,
+                         health.nacks, health.reads, health.strikes,
+                         quarantineLeft);
+    }
+    return ret;
+}
+
+// a hinted pass, a scan and the verification of the fru cache that follows it
+// read the same eeproms, so only one of them runs at a time. What is asked for
+// meanwhile is collected here and served once it is done, hints first
+static bool scanInProgress = false;
+static bool pendingFullScan = false;
+static std::set<size_t> pendingBuses;
+static bool pendingPowerChange = false;
+static ScanHints pendingHints;
+
+static void scanHintedAddresses(
+    boost::asio::io_service& io, BusMap& busmap,
+    boost::container::flat_map<
+        std::pair<size_t, size_t>,
+        std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
+    sdbusplus::asio::object_server& objServer);
+
+// starts whatever was asked for while a pass ran
+static void scanFinished(
+    boost::asio::io_service& io, BusMap& busmap,
+    boost::container::flat_map<
+        std::pair<size_t, size_t>,
+        std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
+    sdbusplus::asio::object_server& objServer)
+{
+    scanInProgress = false;
+    if (!pendingHints.empty())
+    {
+        scanHintedAddresses(io, busmap, dbusInterfaceMap, objServer);
+    }
+    else if (pendingFullScan || !pendingBuses.empty())
+    {
+        rescanBusses(io, busmap, dbusInterfaceMap, objServer,
+                     std::set<size_t>());
+    }
+}
+
+// reads only the hinted addresses and publishes the frus found there that
+// aren't on dbus yet, so they don't wait for a full scan. Whatever changed at
+// an address that is already known is left to rescanBusses
+static void scanHintedAddresses(
     boost::asio::io_service& io, BusMap& busmap,
     boost::container::flat_map<
         std::pair<size_t, size_t>,
         std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
     sdbusplus::asio::object_server& objServer)
+{
+    auto hints = std::make_shared<ScanHints>();
+    hints->swap(pendingHints);
+
+    boost::container::flat_map<size_t, fs::path> busPaths;
+    std::vector<fs::path> i2cBuses;
+    if (getI2cDevicePaths(fs::path("/dev/"), busPaths))
+    {
+        for (const auto& hint : *hints)
+        {
+            auto busPath = busPaths.find(hint.first);
+            if (busPath != busPaths.end())
+            {
+                i2cBuses.emplace_back(busPath->second);
+            }
+        }
+    }
+
+    scanInProgress = true;
+    auto found = std::make_shared<BusMap>();
+    // whatever the hinted addresses didn't answer is left to rescanBusses
+    auto incomplete = std::make_shared<IncompleteBuses>();
+    auto scan = std::make_shared<FindDevicesWithCallback>(
+        i2cBuses, io, *found, *incomplete,
+        [&, found, incomplete]() {
+            for (auto& [bus, devices] : *found)
+            {
+                std::shared_ptr<DeviceMap>& known = busmap[bus];
+                if (!known)
+                {
+                    known = std::make_shared<DeviceMap>();
+                }
+                for (auto& [address, device] : *devices)
+                {
+                    if (known->find(address) != known->end())
+                    {
+                        continue;
+                    }
+                    (*known)[address] = device;
+                    AddFruObjectToDbus(device, objServer, dbusInterfaceMap,
+                                       static_cast<uint32_t>(bus),
+                                       static_cast<uint32_t>(address));
+                }
+            }
+            writeFruCache();
+            scanFinished(io, busmap, dbusInterfaceMap, objServer);
+        },
+        std::move(hints));
+    scan->run();
+}
+
+// queues a pass over the hinted addresses, it runs right away unless a scan is
+// in progress
+static void requestHintedScan(
+    boost::asio::io_service& io, BusMap& busmap,
+    boost::container::flat_map<
+        std::pair<size_t, size_t>,
+        std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
+    sdbusplus::asio::object_server& objServer, const ScanHints& hints)
+{
+    for (const auto& [bus, addresses] : hints)
+    {
+        pendingHints[bus].insert(addresses.begin(), addresses.end());
+    }
+    if (scanInProgress || pendingHints.empty())
+    {
+        return;
+    }
+    scanHintedAddresses(io, busmap, dbusInterfaceMap, objServer);
+}
+
+void rescanBusses(
+    boost::asio::io_service& io, BusMap& busmap,
+    boost::container::flat_map<
+        std::pair<size_t, size_t>,
+        std::shared_ptr<sdbusplus::asio::dbus_interface>>& dbusInterfaceMap,
+    sdbusplus::asio::object_server& objServer,
+    const std::optional<std::set<size_t>>& buses, bool powerChange)
 {
     static boost::asio::deadline_timer timer(io);
+
+    if (buses)
+    {
+        pendingBuses.insert(buses->begin(), buses->end());
+    }
+    else
+    {
+        pendingFullScan = true;
+    }
+    pendingPowerChange = pendingPowerChange || powerChange;
+
+    // the scan runs in the background, requests that come in meanwhile are
+    // served once it is done
+    if (scanInProgress)
+    {
+        return;
+    }
     timer.expires_from_now(boost::posix_time::seconds(1));
 
     // setup an async wait in case we get flooded with requests
-    timer.async_wait([&](const boost::system::error_code&) {
+    timer.async_wait([&](const boost::system::error_code& ec) {
+        if (ec == boost::asio::error::operation_aborted)
+        {
+            // a newer request restarted the timer
+            return;
+        }
+        if (scanInProgress)
+        {
+            // a hinted pass started meanwhile, this runs once it is done
+            return;
+        }
         auto devDir = fs::path("/dev/");
         std::vector<fs::path> i2cBuses;
 
@@ -855,45 +1944,229 @@ void rescanBusses(
             return;
         }
 
-        for (auto busPath : busPaths)
+        // buses whose devices are replaced by the result of this scan, one
+        // that went away ends up with none
+        std::set<size_t> replaced;
+        if (pendingFullScan)
         {
-            i2cBuses.emplace_back(busPath.second);
+            for (auto& busPath : busPaths)
+            {
+                replaced.insert(busPath.first);
+            }
+            for (auto& devicemap : busmap)
+            {
+                replaced.insert(static_cast<size_t>(devicemap.first));
+            }
+            // the baseboard fru isn't on a bus
+            replaced.insert(0);
         }
+        else
+        {
+            replaced = std::move(pendingBuses);
+        }
+        bool scanPowerChange = pendingPowerChange;
+        pendingFullScan = false;
+        pendingBuses.clear();
+        pendingPowerChange = false;
 
-        busmap.clear();
-        auto scan = std::make_shared<FindDevicesWithCallback>(
-            i2cBuses, io, busmap, [&]() {
-                for (auto& busIface : dbusInterfaceMap)
-                {
-                    objServer.remove_interface(busIface.second);
-                }
-
-                dbusInterfaceMap.clear();
-                UNKNOWN_BUS_OBJECT_COUNT = 0;
+        for (size_t bus : replaced)
+        {
+            auto busPath = busPaths.find(bus);
+            if (busPath != busPaths.end())
+            {
+                i2cBuses.emplace_back(busPath->second);
+            }
+        }
 
+        scanInProgress = true;
+        auto found = std::make_shared<BusMap>();
+        auto incomplete = std::make_shared<IncompleteBuses>();
+        auto scan = std::make_shared<FindDevicesWithCallback>(
+            i2cBuses, io, *found, *incomplete,
+            [&, found, incomplete, replaced, scanPowerChange]() {
                 // todo, get this from a more sensable place
                 std::vector<char> baseboardFru;
-                if (readBaseboardFru(baseboardFru))
+                if (replaced.count(0) && readBaseboardFru(baseboardFru))
                 {
                     boost::container::flat_map<int, std::vector<char>>
                         baseboardDev;
                     baseboardDev.emplace(0, baseboardFru);
-                    busmap[0] = std::make_shared<DeviceMap>(baseboardDev);
+                    (*found)[0] = std::make_shared<DeviceMap>(baseboardDev);
+                }
+
+                // devices that read back the same keep their interface, so
+                // nothing changes on dbus for them
+                std::vector<std::pair<size_t, size_t>> added;
+                std::set<size_t> changedBuses;
+                for (size_t bus : replaced)
+                {
+                    int busKey = static_cast<int>(bus);
+                    static const DeviceMap noDevices;
+                    auto findOld = busmap.find(busKey);
+                    auto findNew = found->find(busKey);
+                    auto findIncomplete = incomplete->find(bus);
+                    if (findIncomplete != incomplete->end())
+                    {
+                        if (findNew == found->end())
+                        {
+                            // quarantined, what it had is kept until it can
+                            // be scanned again
+                            continue;
+                        }
+                        // timed out, the devices from the one that hung on
+                        // weren't read and are kept as they were. What was
+                        // read before it is what is there now
+                        if (findOld != busmap.end())
+                        {
+                            findNew->second->insert(
+                                findOld->second->lower_bound(
+                                    findIncomplete->second),
+                                findOld->second->end());
+                        }
+                    }
+                    const DeviceMap& oldDevices =
+                        findOld == busmap.end() ? noDevices : *findOld->second;
+                    const DeviceMap& newDevices =
+                        findNew == found->end() ? noDevices : *findNew->second;
+
+                    for (auto& device : oldDevices)
+                    {
+                        auto same = newDevices.find(device.first);
+                        if (same != newDevices.end() &&
+                            same->second == device.second)
+                        {
+                            continue;
+                        }
+                        changedBuses.insert(bus);
+                        auto iface = dbusInterfaceMap.find(
+                            std::make_pair(bus, size_t(device.first)));
+                        if (iface != dbusInterfaceMap.end())
+                        {
+                            objServer.remove_interface(iface->second);
+                            dbusInterfaceMap.erase(iface);
+                        }
+                    }
+                    for (auto& device : newDevices)
+                    {
+                        auto same = oldDevices.find(device.first);
+                        if (same == oldDevices.end() ||
+                            same->second != device.second)
+                        {
+                            changedBuses.insert(bus);
+                            added.emplace_back(bus, device.first);
+                        }
+                    }
+
+                    if (findNew == found->end())
+                    {
+                        busmap.erase(busKey);
+                    }
+                    else
+                    {
+                        busmap[busKey] = findNew->second;
+                    }
+                }
+
+                for (auto& [bus, address] : added)
+                {
+                    AddFruObjectToDbus(
+                        (*busmap[static_cast<int>(bus)])[static_cast<int>(
+                            address)],
+                        objServer, dbusInterfaceMap,
+                        static_cast<uint32_t>(bus),
+                        static_cast<uint32_t>(address));
                 }
-                for (auto& devicemap : busmap)
+
+                if (scanPowerChange)
                 {
-                    for (auto& device : *devicemap.second)
+                    if (!powerGatedBuses)
                     {
-                        AddFruObjectToDbus(device.second, objServer,
-                                           dbusInterfaceMap, devicemap.first,
-                                           device.first);
+                        powerGatedBuses.emplace();
                     }
+                    powerGatedBuses->insert(changedBuses.begin(),
+                                            changedBuses.end());
                 }
+
+                retryQuarantinedBuses(io, busmap, dbusInterfaceMap, objServer,
+                                      replaced);
+                writeFruCache();
+                // the scan is only done once the frus served from the cache
+                // have been read in full, so no other scan reads the same
+                // eeproms meanwhile. A mismatch is fixed up by scanning the
+                // bus again, which reads the new contents from the refreshed
+                // entry
+                verifyFruCache(io, [&](const std::set<size_t>& changed) {
+                    writeFruCache();
+                    pendingBuses.insert(changed.begin(), changed.end());
+                    scanFinished(io, busmap, dbusInterfaceMap, objServer);
+                });
             });
         scan->run();
     });
 }
 
+// EEPROM exposes in the configuration entity-manager persisted, they give
+// the bus and address of the frus found on the previous boot
+static void loadScanHints(const char* path, ScanHints& hints)
+{
+    std::ifstream configStream(path);
+    if (!configStream.good())
+    {
+        return;
+    }
+    nlohmann::json data = nlohmann::json::parse(configStream, nullptr, false);
+    if (!data.is_object())
+    {
+        return;
+    }
+
+    // templated values are usually numbers, but may be left as strings
+    auto number = [](const nlohmann::json& value) -> std::optional<size_t> {
+        if (value.is_number_unsigned())
+        {
+            return value.get<size_t>();
+        }
+        const std::string* str = value.get_ptr<const std::string*>();
+        if (str != nullptr)
+        {
+            try
+            {
+                return std::stoul(*str, nullptr, 0);
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+        return std::nullopt;
+    };
+
+    for (const auto& record : data)
+    {
+        auto exposes = record.find("Exposes");
+        if (exposes == record.end() || !exposes->is_array())
+        {
+            continue;
+        }
+        for (const auto& expose : *exposes)
+        {
+            auto type = expose.find("Type");
+            auto bus = expose.find("Bus");
+            auto address = expose.find("Address");
+            if (type == expose.end() || *type != "EEPROM" ||
+                bus == expose.end() || address == expose.end())
+            {
+                continue;
+            }
+            std::optional<size_t> busNum = number(*bus);
+            std::optional<size_t> addressNum = number(*address);
+            if (busNum && addressNum && *addressNum <= 0x7f)
+            {
+                hints[*busNum].insert(static_cast<int>(*addressNum));
+            }
+        }
+    }
+}
+
 int main()
 {
     auto devDir = fs::path("/dev/");
@@ -908,6 +2181,8 @@ int main()
 
     // check for and load blacklist with initial buses.
     loadBlacklist(blacklistPath);
+    loadAddressWidthOverrides(addressingPath);
+    loadFruCache();
 
     boost::asio::io_service io;
     auto systemBus = std::make_shared<sdbusplus::asio::connection>(io);
@@ -930,6 +2205,40 @@ int main()
 
     iface->register_method("GetRawFru", getFruInfo);
 
+    ScanHints scanHints;
+    loadScanHints(systemConfigurationPath, scanHints);
+
+    iface->register_method(
+        "SetScanHints",
+        [&](const std::vector<std::tuple<uint32_t, uint32_t>>& hints) {
+            ScanHints newHints;
+            for (const auto& [bus, address] : hints)
+            {
+                if (address > 0x7f)
+                {
+                    throw std::invalid_argument("Invalid Arguments.");
+                }
+                if (scanHints[bus].insert(static_cast<int>(address)).second)
+                {
+                    newHints[bus].insert(static_cast<int>(address));
+                }
+            }
+            requestHintedScan(io, busMap, dbusInterfaceMap, objServer,
+                              newHints);
+        });
+
+    iface->register_method("GetBusHealth", getBusHealth);
+    iface->register_property(
+        "QuarantineBaseSeconds",
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(quarantineBase)
+                .count()));
+    iface->register_property(
+        "QuarantineMaxSeconds",
+        static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::seconds>(quarantineMax)
+                .count()));
+
     iface->register_method("WriteFru", [&](const uint8_t bus,
                                            const uint8_t address,
                                            const std::vector<uint8_t>& data) {
@@ -938,8 +2247,11 @@ int main()
             throw std::invalid_argument("Invalid Arguments.");
             return;
         }
+        // the header and tail may well read back the same
+        eraseFromFruCache(bus, address);
         // schedule rescan on success
-        rescanBusses(io, busMap, dbusInterfaceMap, objServer);
+        rescanBusses(io, busMap, dbusInterfaceMap, objServer,
+                     std::set<size_t>{bus});
     });
     iface->initialize();
 
@@ -954,8 +2266,9 @@ int main()
             auto findPgood = values.find("pgood");
             if (findPgood != values.end())
             {
-
-                rescanBusses(io, busMap, dbusInterfaceMap, objServer);
+                // only the buses that changed on earlier transitions
+                rescanBusses(io, busMap, dbusInterfaceMap, objServer,
+                             powerGatedBuses, true);
             }
         };
 
@@ -971,6 +2284,7 @@ int main()
                       IN_CREATE | IN_MOVED_TO | IN_DELETE);
     std::array<char, 4096> readBuffer;
     std::string pendingBuffer;
+    const std::regex i2cDevRegex(R"(i2c-\d+)");
     // monitor for new i2c devices
     boost::asio::posix::stream_descriptor dirWatch(io, fd);
     std::function<void(const boost::system::error_code, std::size_t)>
@@ -982,7 +2296,7 @@ int main()
                 return;
             }
             pendingBuffer += std::string(readBuffer.data(), bytes_transferred);
-            bool devChange = false;
+            std::set<size_t> changedBuses;
             while (pendingBuffer.size() > sizeof(inotify_event))
             {
                 const inotify_event* iEvent =
@@ -993,18 +2307,19 @@ int main()
                     case IN_CREATE:
                     case IN_MOVED_TO:
                     case IN_DELETE:
-                        if (boost::starts_with(std::string(iEvent->name),
-                                               "i2c"))
+                        std::string name(iEvent->name);
+                        if (std::regex_match(name, i2cDevRegex))
                         {
-                            devChange = true;
+                            changedBuses.insert(std::stoul(name.substr(4)));
                         }
                 }
 
                 pendingBuffer.erase(0, sizeof(inotify_event) + iEvent->len);
             }
-            if (devChange)
+            if (!changedBuses.empty())
             {
-                rescanBusses(io, busMap, dbusInterfaceMap, objServer);
+                rescanBusses(io, busMap, dbusInterfaceMap, objServer,
+                             changedBuses);
             }
 
             dirWatch.async_read_some(boost::asio::buffer(readBuffer),
@@ -1012,7 +2327,9 @@ int main()
         };
 
     dirWatch.async_read_some(boost::asio::buffer(readBuffer), watchI2cBusses);
-    // run the initial scan
+    // the frus expected from the hints are published first, the full scan
+    // follows once they are
+    requestHintedScan(io, busMap, dbusInterfaceMap, objServer, scanHints);
     rescanBusses(io, busMap, dbusInterfaceMap, objServer);
 
     io.run();
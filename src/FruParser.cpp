@@ -0,0 +1,383 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include <FruParser.hpp>
+#include <array>
+
+constexpr size_t commonHeaderSize = 8;
+constexpr size_t multiRecordHeaderSize = 5;
+// type/length byte that ends the fields of an info area
+constexpr uint8_t endOfFields = 0xC1;
+// language codes whose text fields are 8 bit ascii
+constexpr uint8_t languageEnglishDefault = 0;
+constexpr uint8_t languageEnglish = 25;
+
+static uint8_t byteAt(std::string_view bytes, size_t index)
+{
+    return static_cast<uint8_t>(bytes[index]);
+}
+
+static uint16_t wordAt(std::string_view bytes, size_t index)
+{
+    return static_cast<uint16_t>(byteAt(bytes, index) |
+                                 byteAt(bytes, index + 1) << 8);
+}
+
+// areas and records are valid when their bytes sum to 0
+static bool checksumZero(std::string_view bytes)
+{
+    uint8_t sum = 0;
+    for (char byte : bytes)
+    {
+        sum = static_cast<uint8_t>(sum + static_cast<uint8_t>(byte));
+    }
+    return sum == 0;
+}
+
+static void appendUtf8(std::string& out, uint16_t codePoint)
+{
+    if (codePoint < 0x80)
+    {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+std::string FruField::decode(uint8_t language) const
+{
+    std::string value;
+    switch (encoding)
+    {
+        case FruFieldEncoding::bcdPlus:
+        {
+            static constexpr std::array<char, 16> bcdPlus = {
+                '0', '1', '2', '3', '4', '5', '6', '7',
+                '8', '9', ' ', '-', '.', '?', '?', '?'};
+            for (char byte : data)
+            {
+                uint8_t digits = static_cast<uint8_t>(byte);
+                value += bcdPlus[digits >> 4];
+                value += bcdPlus[digits & 0x0F];
+            }
+            break;
+        }
+        case FruFieldEncoding::sixBitAscii:
+        {
+            // four characters packed into every three bytes, lowest bits
+            // first
+            size_t bits = 0;
+            uint32_t pending = 0;
+            for (char byte : data)
+            {
+                pending |= static_cast<uint32_t>(static_cast<uint8_t>(byte))
+                           << bits;
+                bits += 8;
+                while (bits >= 6)
+                {
+                    value += static_cast<char>((pending & 0x3F) + 0x20);
+                    pending >>= 6;
+                    bits -= 6;
+                }
+            }
+            break;
+        }
+        case FruFieldEncoding::text:
+            if (language != languageEnglishDefault &&
+                language != languageEnglish)
+            {
+                // 16 bit unicode, least significant byte first
+                for (size_t ii = 0; ii + 1 < data.size(); ii += 2)
+                {
+                    appendUtf8(value, wordAt(data, ii));
+                }
+                break;
+            }
+            value = data;
+            break;
+        case FruFieldEncoding::binary:
+            value = data;
+            break;
+    }
+
+    size_t end = value.find_last_not_of('\0');
+    value.erase(end == std::string::npos ? 0 : end + 1);
+    return value;
+}
+
+bool FruData::checksumsValid(void) const
+{
+    if (!headerChecksumValid)
+    {
+        return false;
+    }
+    for (const auto* area : {&chassis, &board, &product})
+    {
+        if (*area && !(*area)->checksumValid)
+        {
+            return false;
+        }
+    }
+    for (const FruMultiRecord& record : multiRecords)
+    {
+        if (!record.checksumValid)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool validateFruHeader(std::string_view header)
+{
+    if (header.size() < commonHeaderSize)
+    {
+        return false;
+    }
+    // ipmi spec format version number is currently at 1, verify it
+    if (byteAt(header, 0) != 0x1)
+    {
+        return false;
+    }
+
+    // verify pad is set to 0
+    if (byteAt(header, 6) != 0x0)
+    {
+        return false;
+    }
+
+    // verify offsets are 0, or don't point to another offset
+    std::array<bool, 256> foundOffsets = {};
+    for (size_t ii = 1; ii < 6; ii++)
+    {
+        uint8_t offset = byteAt(header, ii);
+        if (offset == 0)
+        {
+            continue;
+        }
+        if (foundOffsets[offset])
+        {
+            return false;
+        }
+        foundOffsets[offset] = true;
+    }
+
+    return checksumZero(header.substr(0, commonHeaderSize));
+}
+
+// the fields of an info area start at fieldOffset, within the area
+static std::optional<FruInfoArea> parseInfoArea(std::string_view bytes,
+                                                size_t offset,
+                                                size_t fieldOffset)
+{
+    if (offset + 2 > bytes.size())
+    {
+        return std::nullopt;
+    }
+    size_t length = byteAt(bytes, offset + 1) * size_t(8);
+    if (length < fieldOffset + 1 || offset + length > bytes.size())
+    {
+        return std::nullopt;
+    }
+
+    FruInfoArea area;
+    area.data = bytes.substr(offset, length);
+    area.version = byteAt(area.data, 0);
+    area.typeOrLanguage = byteAt(area.data, 2);
+    area.checksumValid = checksumZero(area.data);
+
+    // the last byte is the checksum
+    size_t index = fieldOffset;
+    while (index < length - 1 && byteAt(area.data, index) != endOfFields)
+    {
+        uint8_t typeLength = byteAt(area.data, index);
+        size_t fieldLength = typeLength & 0x3F;
+        index++;
+        if (index + fieldLength > length - 1)
+        {
+            return std::nullopt;
+        }
+        FruField& field = area.fields.emplace_back();
+        field.encoding = static_cast<FruFieldEncoding>(typeLength >> 6);
+        field.data = area.data.substr(index, fieldLength);
+        index += fieldLength;
+    }
+    return area;
+}
+
+static std::vector<FruMultiRecord> parseMultiRecords(std::string_view bytes,
+                                                     size_t offset)
+{
+    std::vector<FruMultiRecord> records;
+    while (offset + multiRecordHeaderSize <= bytes.size())
+    {
+        std::string_view header = bytes.substr(offset, multiRecordHeaderSize);
+        size_t length = byteAt(header, 2);
+        if (offset + multiRecordHeaderSize + length > bytes.size())
+        {
+            break;
+        }
+
+        FruMultiRecord& record = records.emplace_back();
+        record.type = byteAt(header, 0);
+        record.version = byteAt(header, 1) & 0x0F;
+        record.data = bytes.substr(offset + multiRecordHeaderSize, length);
+        uint8_t sum = byteAt(header, 3);
+        for (char byte : record.data)
+        {
+            sum = static_cast<uint8_t>(sum + static_cast<uint8_t>(byte));
+        }
+        record.checksumValid = checksumZero(header) && sum == 0;
+
+        // the end of list bit
+        if (byteAt(header, 1) & 0x80)
+        {
+            break;
+        }
+        offset += multiRecordHeaderSize + length;
+    }
+    return records;
+}
+
+std::optional<FruData> parseFru(std::string_view bytes)
+{
+    if (bytes.size() < commonHeaderSize)
+    {
+        return std::nullopt;
+    }
+
+    FruData fru;
+    fru.formatVersion = byteAt(bytes, 0);
+    fru.headerChecksumValid = checksumZero(bytes.substr(0, commonHeaderSize));
+
+    std::array<size_t, 5> offsets;
+    for (size_t ii = 0; ii < offsets.size(); ii++)
+    {
+        offsets[ii] = byteAt(bytes, ii + 1) * size_t(8);
+    }
+
+    if (offsets[0] != 0)
+    {
+        // there is no length, it runs up to whatever comes next
+        size_t end = bytes.size();
+        for (size_t offset : offsets)
+        {
+            if (offset > offsets[0] && offset < end)
+            {
+                end = offset;
+            }
+        }
+        if (offsets[0] >= end)
+        {
+            return std::nullopt;
+        }
+        fru.internal = bytes.substr(offsets[0], end - offsets[0]);
+    }
+
+    // version, length, then chassis type or language code. The board area
+    // has its manufacturing date after that
+    struct
+    {
+        std::optional<FruInfoArea>& area;
+        size_t offset;
+        size_t fieldOffset;
+    } infoAreas[] = {{fru.chassis, offsets[1], 3},
+                     {fru.board, offsets[2], 6},
+                     {fru.product, offsets[3], 3}};
+    for (auto& info : infoAreas)
+    {
+        if (info.offset == 0)
+        {
+            continue;
+        }
+        info.area = parseInfoArea(bytes, info.offset, info.fieldOffset);
+        if (!info.area)
+        {
+            return std::nullopt;
+        }
+    }
+    if (fru.board)
+    {
+        fru.board->manufactureMinutes =
+            byteAt(fru.board->data, 3) |
+            static_cast<uint32_t>(byteAt(fru.board->data, 4)) << 8 |
+            static_cast<uint32_t>(byteAt(fru.board->data, 5)) << 16;
+    }
+
+    if (offsets[4] != 0)
+    {
+        fru.multiRecords = parseMultiRecords(bytes, offsets[4]);
+    }
+    return fru;
+}
+
+std::optional<FruPowerSupplyInfo>
+    parsePowerSupplyInfo(const FruMultiRecord& record)
+{
+    if (record.type != fruPowerSupplyInfoType || record.data.size() < 24)
+    {
+        return std::nullopt;
+    }
+    std::string_view data = record.data;
+    FruPowerSupplyInfo info;
+    info.overallCapacityWatts = wordAt(data, 0) & 0x0FFF;
+    info.peakVa = wordAt(data, 2);
+    info.inrushCurrentAmps = byteAt(data, 4);
+    info.inrushIntervalMs = byteAt(data, 5);
+    info.lowInputVoltage1 = wordAt(data, 6);
+    info.highInputVoltage1 = wordAt(data, 8);
+    info.lowInputVoltage2 = wordAt(data, 10);
+    info.highInputVoltage2 = wordAt(data, 12);
+    info.lowInputFrequency = byteAt(data, 14);
+    info.highInputFrequency = byteAt(data, 15);
+    info.dropoutToleranceMs = byteAt(data, 16);
+    info.flags = byteAt(data, 17);
+    info.holdUpSeconds = static_cast<uint8_t>(wordAt(data, 18) >> 12);
+    info.peakWatts = wordAt(data, 18) & 0x0FFF;
+    info.combinedVoltage1 = byteAt(data, 20) >> 4;
+    info.combinedVoltage2 = byteAt(data, 20) & 0x0F;
+    info.combinedWatts = wordAt(data, 21);
+    info.tachometerThreshold = byteAt(data, 23);
+    return info;
+}
+
+std::optional<FruDcOutput> parseDcOutput(const FruMultiRecord& record)
+{
+    if (record.type != fruDcOutputType || record.data.size() < 13)
+    {
+        return std::nullopt;
+    }
+    std::string_view data = record.data;
+    FruDcOutput output;
+    output.outputNumber = byteAt(data, 0) & 0x0F;
+    output.standby = byteAt(data, 0) & 0x80;
+    output.nominalVoltage = static_cast<int16_t>(wordAt(data, 1));
+    output.maxNegativeDeviation = static_cast<int16_t>(wordAt(data, 3));
+    output.maxPositiveDeviation = static_cast<int16_t>(wordAt(data, 5));
+    output.rippleAndNoiseMv = wordAt(data, 7);
+    output.minCurrent = wordAt(data, 9);
+    output.maxCurrent = wordAt(data, 11);
+    return output;
+}
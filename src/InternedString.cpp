@@ -0,0 +1,84 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include <InternedString.hpp>
+#include <functional>
+#include <unordered_set>
+
+// node based, so the strings never move once added
+static std::unordered_set<std::string>& table(void)
+{
+    static std::unordered_set<std::string> strings;
+    return strings;
+}
+
+static const std::string& intern(const std::string& str)
+{
+    return *table().emplace(str).first;
+}
+
+InternedString::InternedString() : value(&intern(std::string()))
+{
+}
+
+InternedString::InternedString(const std::string& str) : value(&intern(str))
+{
+}
+
+InternedString::InternedString(const char* str) :
+    value(&intern(std::string(str)))
+{
+}
+
+std::optional<InternedString> InternedString::find(const std::string& str)
+{
+    auto found = table().find(str);
+    if (found == table().end())
+    {
+        return std::nullopt;
+    }
+    return InternedString(&*found);
+}
+
+size_t InternedString::count(void)
+{
+    return table().size();
+}
+
+size_t InternedString::bytes(void)
+{
+    // roughly a node (next pointer, cached hash) plus the bucket per string
+    constexpr size_t nodeOverhead = 3 * sizeof(void*);
+    size_t total = 0;
+    for (const std::string& str : table())
+    {
+        total += stringBytes(str) + nodeOverhead;
+    }
+    return total;
+}
+
+size_t stringBytes(const std::string& str)
+{
+    // short strings live inside the object
+    const char* object = reinterpret_cast<const char*>(&str);
+    std::less<const char*> before;
+    if (!before(str.data(), object) &&
+        before(str.data(), object + sizeof(std::string)))
+    {
+        return sizeof(std::string);
+    }
+    return sizeof(std::string) + str.capacity() + 1;
+}
@@ -251,6 +251,108 @@ void exportDevice(const std::string& type,
     }
 }
 
+void unexportDevice(const std::string& type,
+                    const devices::ExportTemplate& removeTemplate,
+                    const nlohmann::json& configuration)
+{
+    std::string parameters = removeTemplate.parameters;
+    std::string device = removeTemplate.device;
+    std::string name = "unknown";
+    const uint64_t* bus = nullptr;
+    const uint64_t* address = nullptr;
+
+    for (auto keyPair = configuration.begin(); keyPair != configuration.end();
+         keyPair++)
+    {
+        std::string subsituteString;
+
+        if (keyPair.key() == "Name" &&
+            keyPair.value().type() == nlohmann::json::value_t::string)
+        {
+            subsituteString = std::regex_replace(
+                keyPair.value().get<std::string>(), ILLEGAL_NAME_REGEX, "_");
+            name = subsituteString;
+        }
+        else
+        {
+            subsituteString = jsonToString(keyPair.value());
+        }
+
+        if (keyPair.key() == "Bus")
+        {
+            bus = keyPair.value().get_ptr<const uint64_t*>();
+        }
+        else if (keyPair.key() == "Address")
+        {
+            address = keyPair.value().get_ptr<const uint64_t*>();
+        }
+        boost::replace_all(parameters, TEMPLATE_CHAR + keyPair.key(),
+                           subsituteString);
+        boost::replace_all(device, TEMPLATE_CHAR + keyPair.key(),
+                           subsituteString);
+    }
+
+    if (bus != nullptr && address != nullptr)
+    {
+        std::ostringstream hex;
+        hex << std::hex << std::setfill('0') << std::setw(4) << *address;
+        std::filesystem::path devicePath =
+            std::filesystem::path(device).parent_path() /
+            (std::to_string(*bus) + "-" + hex.str());
+        if (!std::filesystem::is_directory(devicePath))
+        {
+            return; // never exported
+        }
+    }
+
+    if (boost::ends_with(type, "Mux"))
+    {
+        std::error_code ec;
+        std::filesystem::remove_all(
+            std::filesystem::path(MUX_SYMLINK_DIR) / name, ec);
+    }
+
+    std::ofstream deviceFile(device);
+    if (!deviceFile.good())
+    {
+        std::cerr << "Error writing " << device << "\n";
+        return;
+    }
+    deviceFile << parameters;
+}
+
+void removeOverlay(const nlohmann::json& configuration)
+{
+    auto findName = configuration.find("Name");
+    if (findName == configuration.end() ||
+        findName->type() != nlohmann::json::value_t::string)
+    {
+        return;
+    }
+    std::string name = std::regex_replace(findName->get<std::string>(),
+                                          ILLEGAL_NAME_REGEX, "_");
+    std::string overlay = name + "_" + configuration["Type"].get<std::string>();
+
+    std::filesystem::path dtboFilename =
+        std::filesystem::path(OUTPUT_DIR) / (overlay + ".dtbo");
+    if (!std::filesystem::exists(dtboFilename))
+    {
+        return; // never loaded
+    }
+
+    boost::process::child c(DT_OVERLAY, "-d", OUTPUT_DIR, "-r", overlay);
+    c.wait();
+    if (c.exit_code())
+    {
+        std::cerr << "DTOverlay error removing " << overlay << "\n";
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(dtboFilename, ec);
+    std::filesystem::remove(
+        std::filesystem::path(OUTPUT_DIR) / (overlay + ".dts"), ec);
+}
+
 // this is now deprecated
 void createOverlay(const std::string& templatePath,
                    const nlohmann::json& configuration)
@@ -411,3 +513,44 @@ bool loadOverlays(const nlohmann::json& systemConfiguration)
 
     return true;
 }
+
+void unloadOverlays(const nlohmann::json& systemConfiguration)
+{
+    for (auto entity = systemConfiguration.begin();
+         entity != systemConfiguration.end(); entity++)
+    {
+        auto findExposes = entity.value().find("Exposes");
+        if (findExposes == entity.value().end() ||
+            findExposes->type() != nlohmann::json::value_t::array)
+        {
+            continue;
+        }
+
+        // reverse order so devices behind a mux go before the mux does
+        for (auto configuration = findExposes->rbegin();
+             configuration != findExposes->rend(); configuration++)
+        {
+            auto findStatus = configuration->find("Status");
+            if (findStatus != configuration->end() &&
+                *findStatus == "disabled")
+            {
+                continue;
+            }
+            auto findType = configuration->find("Type");
+            if (findType == configuration->end() ||
+                findType->type() != nlohmann::json::value_t::string)
+            {
+                continue;
+            }
+            std::string type = findType.value().get<std::string>();
+#if OVERLAYS
+            removeOverlay(*configuration);
+#endif
+            auto device = devices::removeTemplates.find(type.c_str());
+            if (device != devices::removeTemplates.end())
+            {
+                unexportDevice(type, device->second, *configuration);
+            }
+        }
+    }
+}
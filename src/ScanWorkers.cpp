@@ -0,0 +1,146 @@
+/*
+// Copyright (c) 2019 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <ScanWorkers.hpp>
+#include <boost/asio/read.hpp>
+#include <cerrno>
+#include <iostream>
+#include <system_error>
+
+ScanWorkers::ScanWorkers(boost::asio::io_service& io, size_t threadCount) :
+    wakeup(io)
+{
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(),
+                                "unable to create scan worker eventfd");
+    }
+    wakeup.assign(fd);
+
+    for (size_t ii = 0; ii < threadCount; ii++)
+    {
+        threads.emplace_back([this]() { worker(); });
+    }
+}
+
+ScanWorkers::~ScanWorkers()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void ScanWorkers::post(std::function<void(void)>&& work,
+                       std::function<void(bool failed)>&& done)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        jobs.emplace_back(std::move(work), std::move(done));
+    }
+    workAvailable.notify_one();
+    outstanding++;
+    waitForCompleted();
+}
+
+void ScanWorkers::worker(void)
+{
+    while (true)
+    {
+        std::pair<std::function<void(void)>, std::function<void(bool)>> job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            workAvailable.wait(guard,
+                               [this]() { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+            {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        bool failed = false;
+        try
+        {
+            job.first();
+        }
+        catch (const std::exception& e)
+        {
+            // the completion handler still runs so the scan can finish
+            std::cerr << "scan worker failed: " << e.what() << "\n";
+            failed = true;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            completed.emplace_back(std::move(job.second), failed);
+        }
+        uint64_t one = 1;
+        if (write(wakeup.native_handle(), &one, sizeof(one)) < 0)
+        {
+            std::cerr << "unable to wake io thread\n";
+        }
+    }
+}
+
+void ScanWorkers::waitForCompleted(void)
+{
+    if (waiting || !outstanding)
+    {
+        return;
+    }
+    waiting = true;
+    boost::asio::async_read(
+        wakeup, boost::asio::buffer(&wakeupCount, sizeof(wakeupCount)),
+        [this](const boost::system::error_code& ec, std::size_t) {
+            waiting = false;
+            if (ec == boost::asio::error::operation_aborted)
+            {
+                return;
+            }
+            if (ec)
+            {
+                std::cerr << "error reading scan worker eventfd " << ec
+                          << "\n";
+            }
+            runCompleted();
+            waitForCompleted();
+        });
+}
+
+void ScanWorkers::runCompleted(void)
+{
+    std::deque<std::pair<std::function<void(bool)>, bool>> ready;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ready.swap(completed);
+    }
+    for (auto& [done, failed] : ready)
+    {
+        outstanding--;
+        done(failed);
+    }
+}
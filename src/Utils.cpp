@@ -101,12 +101,14 @@ bool isPowerOn(void)
     return powerStatusOn;
 }
 
-void setupPowerMatch(const std::shared_ptr<sdbusplus::asio::connection>& conn)
+void setupPowerMatch(const std::shared_ptr<sdbusplus::asio::connection>& conn,
+                     std::function<void(bool)>&& powerChanged)
 {
     // create a match for powergood changes, first time do a method call to
     // cache the correct value
     std::function<void(sdbusplus::message::message & message)> eventHandler =
-        [](sdbusplus::message::message& message) {
+        [powerChanged{std::move(powerChanged)}](
+            sdbusplus::message::message& message) {
             std::string objectName;
             boost::container::flat_map<std::string, std::variant<int32_t, bool>>
                 values;
@@ -114,7 +116,16 @@ void setupPowerMatch(const std::shared_ptr<sdbusplus::asio::connection>& conn)
             auto findPgood = values.find("pgood");
             if (findPgood != values.end())
             {
-                powerStatusOn = std::get<int32_t>(findPgood->second);
+                bool on = std::get<int32_t>(findPgood->second);
+                if (on == powerStatusOn)
+                {
+                    return;
+                }
+                powerStatusOn = on;
+                if (powerChanged)
+                {
+                    powerChanged(on);
+                }
             }
         };
 